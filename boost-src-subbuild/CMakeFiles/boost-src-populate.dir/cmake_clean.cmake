@@ -0,0 +1,17 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/boost-src-populate"
+  "CMakeFiles/boost-src-populate-complete"
+  "boost-src-populate-prefix/src/boost-src-populate-stamp/boost-src-populate-build"
+  "boost-src-populate-prefix/src/boost-src-populate-stamp/boost-src-populate-configure"
+  "boost-src-populate-prefix/src/boost-src-populate-stamp/boost-src-populate-download"
+  "boost-src-populate-prefix/src/boost-src-populate-stamp/boost-src-populate-install"
+  "boost-src-populate-prefix/src/boost-src-populate-stamp/boost-src-populate-mkdir"
+  "boost-src-populate-prefix/src/boost-src-populate-stamp/boost-src-populate-patch"
+  "boost-src-populate-prefix/src/boost-src-populate-stamp/boost-src-populate-test"
+  "boost-src-populate-prefix/src/boost-src-populate-stamp/boost-src-populate-update"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang )
+  include(CMakeFiles/boost-src-populate.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
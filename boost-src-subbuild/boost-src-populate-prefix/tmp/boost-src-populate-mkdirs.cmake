@@ -0,0 +1,22 @@
+# Distributed under the OSI-approved BSD 3-Clause License.  See accompanying
+# file Copyright.txt or https://cmake.org/licensing for details.
+
+cmake_minimum_required(VERSION 3.5)
+
+file(MAKE_DIRECTORY
+  "/root/repo/boost"
+  "/root/repo/boost-src-build"
+  "/root/repo/boost-src-subbuild/boost-src-populate-prefix"
+  "/root/repo/boost-src-subbuild/boost-src-populate-prefix/tmp"
+  "/root/repo/boost-src-subbuild/boost-src-populate-prefix/src/boost-src-populate-stamp"
+  "/root/repo/boost-src-subbuild/boost-src-populate-prefix/src"
+  "/root/repo/boost-src-subbuild/boost-src-populate-prefix/src/boost-src-populate-stamp"
+)
+
+set(configSubDirs )
+foreach(subDir IN LISTS configSubDirs)
+    file(MAKE_DIRECTORY "/root/repo/boost-src-subbuild/boost-src-populate-prefix/src/boost-src-populate-stamp/${subDir}")
+endforeach()
+if(cfgdir)
+  file(MAKE_DIRECTORY "/root/repo/boost-src-subbuild/boost-src-populate-prefix/src/boost-src-populate-stamp${cfgdir}") # cfgdir has leading slash
+endif()
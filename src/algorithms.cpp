@@ -5,11 +5,17 @@
 #include <atomic>
 #include <iostream>
 #include <chrono>
+#include <iomanip>
 #include <limits>
-#include <thread>
+#include <memory>
+#include <numeric>
+#include <optional>
 
 #include "config.h"
+#include "flow.h"
 #include "io.h"
+#include "lap.h"
+#include "thread_pool.h"
 
 using EdgeProperty = boost::property<boost::edge_weight_t, uint32_t>;
 using Graph = boost::adjacency_list<boost::vecS, boost::vecS, boost::undirectedS,
@@ -22,6 +28,7 @@ using GraphTraits = boost::graph_traits<Graph>;
 // ##########################################
 
 void printCurrentAssignment(const State &s) {
+  flushLog();
   std::cout << std::endl;
   for (GroupID group = 0; group < s.numGroups(); ++group) {
     const GroupData &gd = s.groupData(group);
@@ -52,6 +59,21 @@ bool combinationIsValid(const TeamData &team, const GroupData &group,
   return valid;
 }
 
+bool combinationIsValid(const State &s, ParticipantID part, GroupID group) {
+  if (s.isTeam(part)) {
+    return combinationIsValid(s.teamData(part), s.groupData(group), s.data().students);
+  }
+  return combinationIsValid(s.studentData(part), s.groupData(group));
+}
+
+uint64_t totalWeight(const State &s) {
+  uint64_t result = 0;
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    result += s.groupWeight(group);
+  }
+  return result;
+}
+
 // returns a factor for the weights of a single participant
 double getFactor(const State &/*s*/, ParticipantID /*part*/) {
   // if (s.isTeam(part)) {
@@ -68,15 +90,18 @@ double getFactor(const State &/*s*/, ParticipantID /*part*/) {
   return 1.0;
 }
 
-// global variables for interrupt handling
-static std::atomic_bool interrupted(false);
-static std::atomic_bool finished(false);
+// a matching calculation, shared with the (detached) thread that calculates it
+struct MatchingComputation {
+  Graph graph;
+  std::vector<GraphTraits::vertex_descriptor> mates;
+  std::atomic_bool finished = false;
+};
 
 void signalHandler(int) {
-  if (interrupted.load()) {
+  if (interruptRequested()) {
     std::exit(-1);
   }
-  interrupted.store(true);
+  requestCancellation();
 }
 
 // ####################################
@@ -90,15 +115,51 @@ uint32_t newRandomNumber(std::mt19937_64& gen, uint32_t min, uint32_t max) {
   return dist(gen);
 }
 
-GroupID computeNumberOfGeneratedEdges(GroupID size_of_group) {
-  // probability of uncovered slot is roughly NUM_SLOTS * e^-SPARSIFIED_NUM_EDGES
-  const GroupID sparsified_num_edges_base = 10;
-  return sparsified_num_edges_base + std::ceil(std::log(size_of_group));
+// --matching-engine=auto uses the dense engine up to this number of participant-slot pairs
+constexpr size_t MAX_AUTO_DENSE_ENTRIES = 1 << 22;
+
+// probability of uncovered slot is roughly NUM_SLOTS * e^-SPARSIFIED_NUM_EDGES
+constexpr GroupID SPARSIFIED_NUM_EDGES_BASE = 10;
+
+GroupID computeNumberOfGeneratedEdges(GroupID size_of_group, GroupID base = SPARSIFIED_NUM_EDGES_BASE) {
+  return base + std::ceil(std::log(size_of_group));
 }
 
-std::vector<GroupID> createRandomSubsetOfIDs(std::mt19937_64& gen, GroupID num_generated, GroupID max_index) {
+// Approximate memory usage of the engines in bytes, used for --memory-limit. The blossom algorithm
+// of boost allocates a table with an entry per pair of vertices, so it dominates for large inputs.
+constexpr size_t BLOSSOM_BYTES_PER_VERTEX_PAIR = sizeof(std::pair<GraphTraits::edge_descriptor, bool>);
+constexpr size_t BLOSSOM_BYTES_PER_VERTEX = 128;
+constexpr size_t BLOSSOM_BYTES_PER_EDGE = 80;
+constexpr size_t DENSE_BYTES_PER_ENTRY = sizeof(int64_t);
+constexpr size_t FLOW_BYTES_PER_PAIR = 64;
+
+size_t estimateBlossomMemory(size_t num_vertices, size_t num_edges) {
+  return num_vertices * num_vertices * BLOSSOM_BYTES_PER_VERTEX_PAIR + num_vertices * BLOSSOM_BYTES_PER_VERTEX
+         + num_edges * BLOSSOM_BYTES_PER_EDGE;
+}
+
+// number of edges of the graph for the participant-group pairs, sparsified with the given base
+size_t estimateNumberOfEdges(const std::vector<size_t>& valid_pairs, const std::vector<size_t>& rated_pairs,
+                             const std::vector<GraphTraits::vertex_descriptor>& first_group_vertex,
+                             bool sparsify, GroupID base) {
+  size_t result = 0;
+  for (GroupID k = 0; k + 1 < first_group_vertex.size(); ++k) {
+    const GroupID capacity = first_group_vertex[k + 1] - first_group_vertex[k];
+    if (!sparsify) {
+      result += valid_pairs[k] * capacity;
+    } else {
+      const GroupID num_edges = computeNumberOfGeneratedEdges(capacity, base);
+      result += rated_pairs[k] * ((num_edges + 2 < capacity) ? num_edges : capacity);
+    }
+  }
+  return result;
+}
+
+// writes the sorted subset to result
+void createRandomSubsetOfIDs(std::mt19937_64& gen, GroupID num_generated, GroupID max_index,
+                             std::vector<GroupID>& result) {
   ASSERT(max_index > num_generated + 1);
-  std::vector<GroupID> result;
+  result.clear();
   for (GroupID count = 0; count < num_generated; ++count) {
     GroupID next = newRandomNumber(gen, 0, max_index - 1 - result.size());
     for (size_t i = 0; i <= result.size(); ++i) {
@@ -117,151 +178,552 @@ std::vector<GroupID> createRandomSubsetOfIDs(std::mt19937_64& gen, GroupID num_g
   for (size_t i = 1; i < result.size(); ++i) {
     ASSERT(result[i - 1] < result[i] && result[i] < max_index);
   }
-  return result;
 }
 
-std::pair<std::vector<int32_t>, bool> calculateAssignmentImpl(const State &s, std::mt19937_64& gen, bool top_level, bool restart) {
-  // initialize vertices
+// Scratch vectors of calculateComponentAssignment. Workspaces are reused by later solves on the same thread,
+// so these vectors keep their capacity and steady-state iterations don't allocate them again. Everything
+// else is still allocated per solve: the graph (its edge lists are node based, so clearing it would not
+// keep the memory), the MatchingComputation shared with the pool task and the returned assignment.
+struct SolverWorkspace {
   std::vector<GraphTraits::vertex_descriptor> first_group_vertex;
   std::vector<GroupID> vertex_to_group;
-  first_group_vertex.push_back(0);
-  for (GroupID group = 0; group < s.numGroups(); ++group) {
-    if (s.groupIsEnabled(group)) {
-      for (StudentID i = 0; i < s.groupCapacity(group); ++i) {
-        vertex_to_group.push_back(group);
+  std::vector<GraphTraits::vertex_descriptor> mates;
+  std::vector<GroupID> target_slots_within_group;
+  std::vector<int32_t> slot_bonus;
+  // participants x slots, for the dense engine
+  std::vector<int64_t> dense_costs;
+};
+
+// Takes a workspace from the free list of the current thread and returns it on destruction. A list is
+// required since a worker might start another solve while waiting for its matching.
+class WorkspaceLease {
+  static thread_local std::vector<std::unique_ptr<SolverWorkspace>> free_workspaces;
+  std::unique_ptr<SolverWorkspace> _workspace;
+
+ public:
+  WorkspaceLease() {
+    if (free_workspaces.empty()) {
+      _workspace = std::make_unique<SolverWorkspace>();
+    } else {
+      _workspace = std::move(free_workspaces.back());
+      free_workspaces.pop_back();
+    }
+  }
+
+  ~WorkspaceLease() {
+    free_workspaces.push_back(std::move(_workspace));
+  }
+
+  SolverWorkspace& operator*() {
+    return *_workspace;
+  }
+};
+
+thread_local std::vector<std::unique_ptr<SolverWorkspace>> WorkspaceLease::free_workspaces;
+
+// weight of the participant for the least attractive slot of the group
+uint32_t baseEdgeWeight(const State &s, ParticipantID part, GroupID group, Rating rating, double factor) {
+  const int64_t priced_rating = static_cast<int64_t>(ceil(factor * rating.getValue(s.numGroups())))
+                                - s.participantPrice(part, group) - s.movePenalty(part, group);
+  return std::max<int64_t>(1, priced_rating);
+}
+
+uint32_t baseEdgeWeight(const State &s, ParticipantID part, GroupID group, double factor) {
+  return baseEdgeWeight(s, part, group, s.rating(part).at(group), factor);
+}
+
+// calls fn(k, rating) for each of the (ascending) groups the participant can be assigned to
+template <typename F>
+void forEachValidGroup(const State &s, ParticipantID part, const std::vector<GroupID>& groups, F&& fn) {
+  GroupID k = 0;
+  for (const auto [group, rating] : s.rating(part)) {
+    if (k == groups.size()) {
+      break;
+    } else if (group != groups[k]) {
+      continue;
+    }
+    if (rating.isValid() && !s.isExludedFromGroup(part, group) && combinationIsValid(s, part, group)) {
+      fn(k, rating);
+    }
+    ++k;
+  }
+}
+
+// Solves the matching as min cost flow on classes of interchangeable participants, i.e. participants
+// with the same weight for every group. Since the weight of a slot is the base weight of the participant
+// plus the bonus of the slot, the flow goes from the classes (supply = size of the class) to the groups
+// and from each group to the sink over one arc per bonus level.
+bool calculateClassFlowAssignment(const State &s, bool top_level,
+                                  const std::vector<ParticipantID>& participants,
+                                  const std::vector<GroupID>& groups,
+                                  const std::vector<GraphTraits::vertex_descriptor>& first_group_vertex,
+                                  const std::vector<int32_t>& slot_bonus,
+                                  std::vector<int32_t>& assignment, int64_t& total_weight) {
+  std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+  constexpr int64_t INVALID = -1;
+  const size_t num_groups = groups.size();
+
+  // weight row of each participant, INVALID if the group is not available
+  std::vector<int64_t> rows(participants.size() * num_groups, INVALID);
+  int64_t max_weight = 0;
+  for (ParticipantID i = 0; i < participants.size(); ++i) {
+    const ParticipantID part = participants[i];
+    const double factor = getFactor(s, part);
+    forEachValidGroup(s, part, groups, [&](GroupID k, Rating rating) {
+      rows[i * num_groups + k] = baseEdgeWeight(s, part, groups[k], rating, factor);
+      max_weight = std::max(max_weight, rows[i * num_groups + k]);
+    });
+  }
+  std::vector<ParticipantID> order(participants.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](ParticipantID a, ParticipantID b) {
+    return std::lexicographical_compare(&rows[a * num_groups], &rows[(a + 1) * num_groups],
+                                        &rows[b * num_groups], &rows[(b + 1) * num_groups]);
+  });
+  // members of each class (indices into participants)
+  std::vector<std::vector<ParticipantID>> classes;
+  for (size_t idx = 0; idx < order.size(); ++idx) {
+    if (idx == 0 || !std::equal(&rows[order[idx] * num_groups], &rows[(order[idx] + 1) * num_groups],
+                                &rows[order[idx - 1] * num_groups])) {
+      classes.emplace_back();
+    }
+    classes.back().push_back(order[idx]);
+  }
+
+  // nodes: source, classes, groups, sink
+  const size_t source = 0;
+  const size_t first_group_node = 1 + classes.size();
+  const size_t sink = first_group_node + num_groups;
+  MinCostFlow flow(sink + 1);
+  int32_t max_bonus = 0;
+  for (int32_t bonus : slot_bonus) {
+    max_bonus = std::max(max_bonus, bonus);
+  }
+  std::vector<std::vector<std::pair<GroupID, size_t>>> class_arcs(classes.size());
+  for (size_t c = 0; c < classes.size(); ++c) {
+    flow.addArc(source, 1 + c, classes[c].size(), 0);
+    const int64_t* row = &rows[classes[c][0] * num_groups];
+    for (GroupID k = 0; k < num_groups; ++k) {
+      if (row[k] != INVALID) {
+        class_arcs[c].emplace_back(k, flow.addArc(1 + c, first_group_node + k, classes[c].size(), max_weight - row[k]));
       }
     }
+  }
+  std::vector<std::pair<int32_t, size_t>> sink_arcs;
+  for (GroupID k = 0; k < num_groups; ++k) {
+    for (size_t slot = first_group_vertex[k]; slot < first_group_vertex[k + 1];) {
+      size_t end = slot;
+      while (end < first_group_vertex[k + 1] && slot_bonus[end] == slot_bonus[slot]) {
+        ++end;
+      }
+      sink_arcs.emplace_back(slot_bonus[slot], flow.addArc(first_group_node + k, sink, end - slot,
+                                                           max_bonus - slot_bonus[slot]));
+      slot = end;
+    }
+  }
+  flow.solve(source, sink);
+  if (cancellationRequested()) {
+    ERROR("Interrupted (SIGINT or time limit).", true);
+    return false;
+  }
+
+  // expand the classes to the participants
+  bool success = true;
+  ParticipantID num_assigned = 0;
+  total_weight = 0;
+  for (size_t c = 0; c < classes.size(); ++c) {
+    size_t next_member = 0;
+    const int64_t* row = &rows[classes[c][0] * num_groups];
+    for (const auto& [k, arc] : class_arcs[c]) {
+      for (int64_t f = flow.flow(arc); f > 0; --f) {
+        assignment[participants[classes[c][next_member++]]] = groups[k];
+        total_weight += row[k];
+        ++num_assigned;
+      }
+    }
+    for (; next_member < classes[c].size(); ++next_member) {
+      const ParticipantID part = participants[classes[c][next_member]];
+      const std::string &name =
+          s.isTeam(part) ? s.teamData(part).id : s.studentData(part).name;
+      ERROR("Participant \"" << name << "\" not assigned!", top_level);
+      success = false;
+    }
+  }
+  for (const auto& [bonus, arc] : sink_arcs) {
+    total_weight += bonus * flow.flow(arc);
+  }
+  MAJOR_PROGRESS("Flow with size " << num_assigned << " on " << classes.size()
+                 << " participant classes and total weight " << total_weight
+                 << " calculated ("
+                 << std::chrono::duration<double>(std::chrono::system_clock::now() - start).count()
+                 << " s).", top_level);
+  return success;
+}
+
+// Inserts the participants left unmatched by the sparsified matching without solving the complete graph
+// again. For each participant, a breadth first search over the groups finds the shortest chain of moves
+// (the participant enters a group, a member of this group moves to the next group, ...) which ends in a
+// free slot, using all edges of the participants on the chain. Among the shortest chains, the one with
+// the highest weight is applied, the rest of the matching is kept. Returns false if a participant can't
+// be inserted.
+// This is a heuristic: the participants are inserted greedily one after another and only along shortest
+// chains, so the result is a valid matching but not necessarily of maximum weight (unlike the restart).
+bool repairSparsifiedMatching(const State &s, const std::vector<ParticipantID>& participants,
+                              const std::vector<GroupID>& groups,
+                              const std::vector<GraphTraits::vertex_descriptor>& first_group_vertex,
+                              const std::vector<int32_t>& slot_bonus,
+                              const std::vector<ParticipantID>& unmatched,
+                              std::vector<GraphTraits::vertex_descriptor>& mates, int64_t& total_weight) {
+  const GraphTraits::vertex_descriptor first_participant = slot_bonus.size();
+  const GraphTraits::vertex_descriptor free_slot = GraphTraits::null_vertex();
+  const GroupID num_groups = groups.size();
+  constexpr int64_t NO_EDGE = -1;
+  auto weight = [&](ParticipantID i, GroupID k) -> int64_t {
+    const ParticipantID part = participants[i];
+    if (s.isExludedFromGroup(part, groups[k]) || !combinationIsValid(s, part, groups[k])) {
+      return NO_EDGE;
+    }
+    return baseEdgeWeight(s, part, groups[k], getFactor(s, part));
+  };
+
+  constexpr uint32_t UNREACHED = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> depth(num_groups);
+  std::vector<int64_t> gain(num_groups);
+  // the previous group of the chain (num_groups for the first) and the participant that enters the group
+  std::vector<std::pair<GroupID, ParticipantID>> previous(num_groups);
+  std::vector<GroupID> layer, next_layer;
+  for (ParticipantID i : unmatched) {
+    std::fill(depth.begin(), depth.end(), UNREACHED);
+    layer.clear();
+    for (GroupID k = 0; k < num_groups; ++k) {
+      const int64_t w = weight(i, k);
+      if (w != NO_EDGE && first_group_vertex[k] < first_group_vertex[k + 1]) {
+        depth[k] = 0;
+        gain[k] = w;
+        previous[k] = {num_groups, i};
+        layer.push_back(k);
+      }
+    }
+
+    GraphTraits::vertex_descriptor target_slot = free_slot;
+    GroupID target = num_groups;
+    int64_t target_gain = 0;
+    for (uint32_t current_depth = 0; !layer.empty(); ++current_depth) {
+      for (GroupID k : layer) {
+        for (auto v = first_group_vertex[k]; v < first_group_vertex[k + 1]; ++v) {
+          if (mates[v] == free_slot && (target == num_groups || gain[k] + slot_bonus[v] > target_gain)) {
+            target = k;
+            target_slot = v;
+            target_gain = gain[k] + slot_bonus[v];
+          }
+        }
+      }
+      if (target < num_groups) {
+        break;
+      }
+      // each member of the layer might move to a group which is not yet reached
+      next_layer.clear();
+      for (GroupID k : layer) {
+        for (auto v = first_group_vertex[k]; v < first_group_vertex[k + 1]; ++v) {
+          const ParticipantID j = mates[v] - first_participant;
+          const int64_t leave_weight = weight(j, k);
+          for (GroupID l = 0; l < num_groups; ++l) {
+            if (depth[l] < current_depth + 1) {
+              continue;
+            }
+            const int64_t w = weight(j, l);
+            if (w == NO_EDGE) {
+              continue;
+            }
+            const int64_t new_gain = gain[k] - leave_weight + w;
+            if (depth[l] == UNREACHED) {
+              depth[l] = current_depth + 1;
+              next_layer.push_back(l);
+            } else if (new_gain <= gain[l]) {
+              continue;
+            }
+            gain[l] = new_gain;
+            previous[l] = {k, j};
+          }
+        }
+      }
+      std::swap(layer, next_layer);
+    }
+    if (target == num_groups) {
+      return false;
+    }
+
+    // apply the chain backwards, each participant takes the slot of its successor
+    GraphTraits::vertex_descriptor slot = target_slot;
+    for (GroupID k = target; k < num_groups;) {
+      const auto [previous_group, j] = previous[k];
+      const GraphTraits::vertex_descriptor old_slot = mates[first_participant + j];
+      mates[slot] = first_participant + j;
+      mates[first_participant + j] = slot;
+      slot = old_slot;
+      k = previous_group;
+    }
+    total_weight += target_gain;
+  }
+  return true;
+}
+
+// Builds and solves the matching of the participants to the slots of the (enabled) groups. Writes the
+// group of each participant to `assignment` and returns false if any of them is not assigned.
+bool calculateComponentAssignment(const State &s, std::mt19937_64& gen, bool top_level, bool restart,
+                                  const std::vector<ParticipantID>& participants,
+                                  const std::vector<GroupID>& groups,
+                                  std::vector<int32_t>& assignment, int64_t& total_weight) {
+  WorkspaceLease lease;
+  SolverWorkspace& workspace = *lease;
+  std::vector<GraphTraits::vertex_descriptor>& first_group_vertex = workspace.first_group_vertex;
+  std::vector<GroupID>& vertex_to_group = workspace.vertex_to_group;
+  std::vector<GroupID>& target_slots_within_group = workspace.target_slots_within_group;
+  first_group_vertex.clear();
+  vertex_to_group.clear();
+
+  // initialize vertices, the groups are indexed by their position in `groups`
+  first_group_vertex.push_back(0);
+  for (GroupID group : groups) {
+    for (StudentID i = 0; i < s.groupCapacity(group); ++i) {
+      vertex_to_group.push_back(group);
+    }
     first_group_vertex.push_back(vertex_to_group.size());
   }
-  std::vector<ParticipantID> participants;
   const GraphTraits::vertex_descriptor first_participant =
       vertex_to_group.size();
-  GraphTraits::vertex_descriptor num_vertices = first_participant;
-  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
-    if (!s.isAssigned(part)) {
-      num_vertices++;
-      participants.push_back(part);
+  const GraphTraits::vertex_descriptor num_vertices = first_participant + participants.size();
+
+  // Gradually increase the rating so some of the places in the group are better than others.
+  // This nudges the algorithm to distribute students more evenly among groups, thereby
+  // fullfilling the minimum group sizes. The bonus per slot only depends on the group.
+  const Config& config = Config::get();
+  std::vector<int32_t>& slot_bonus = workspace.slot_bonus;
+  slot_bonus.clear();
+  for (GroupID k = 0; k < groups.size(); ++k) {
+    const std::vector<int32_t>& group_bonus = s.slotBonus(groups[k]);
+    ASSERT(group_bonus.size() == first_group_vertex[k + 1] - first_group_vertex[k]);
+    slot_bonus.insert(slot_bonus.end(), group_bonus.begin(), group_bonus.end());
+  }
+  ASSERT(slot_bonus.size() == first_participant);
+
+  // the dense engine uses all slots and therefore no edge sparsification
+  const size_t num_slots = first_participant;
+  MatchingEngine engine = config.matching_engine;
+  if (participants.size() > num_slots && engine == MatchingEngine::Lapjv) {
+    engine = MatchingEngine::Blossom;
+  } else if (engine == MatchingEngine::Auto) {
+    engine = (participants.size() <= num_slots && participants.size() * num_slots <= MAX_AUTO_DENSE_ENTRIES)
+             ? MatchingEngine::Lapjv : MatchingEngine::Blossom;
+  }
+  GroupID sparsified_edges_base = SPARSIFIED_NUM_EDGES_BASE;
+  if (config.memory_limit > 0 && engine != MatchingEngine::Flow) {
+    // estimate the size of the graph before building it and choose the sparsification or engine accordingly.
+    // Each waiting thread of the pool might run a matching at the same time, so they share the limit
+    const size_t limit = (static_cast<size_t>(config.memory_limit) << 20) / ThreadPool::get().numThreads();
+    const Rating min_rating = Rating::minRating(s.numGroups());
+    std::vector<size_t> valid_pairs(groups.size(), 0);
+    std::vector<size_t> rated_pairs(groups.size(), 0);
+    for (ParticipantID part : participants) {
+      forEachValidGroup(s, part, groups, [&](GroupID k, Rating rating) {
+        ++valid_pairs[k];
+        rated_pairs[k] += (restart || rating != min_rating) ? 1 : 0;
+      });
+    }
+    const MatchingEngine requested_engine = engine;
+    const size_t dense_memory = participants.size() * num_slots * DENSE_BYTES_PER_ENTRY;
+    const bool sparse_graph = config.edge_sparsification;
+    auto blossom_memory = [&](GroupID base) {
+      return estimateBlossomMemory(num_vertices, estimateNumberOfEdges(valid_pairs, rated_pairs, first_group_vertex,
+                                                                       sparse_graph, base));
+    };
+    size_t memory = (engine == MatchingEngine::Lapjv) ? dense_memory : blossom_memory(sparsified_edges_base);
+    // the table of the blossom algorithm is quadratic in the number of vertices, so less edges only help if it fits
+    if (engine == MatchingEngine::Blossom && sparse_graph && estimateBlossomMemory(num_vertices, 0) <= limit) {
+      while (memory > limit && sparsified_edges_base > 1) {
+        memory = blossom_memory(--sparsified_edges_base);
+      }
+    }
+    if (memory > limit && engine == MatchingEngine::Blossom && participants.size() <= num_slots
+        && dense_memory <= limit) {
+      engine = MatchingEngine::Lapjv;
+      memory = dense_memory;
+    }
+    if (memory > limit) {
+      engine = MatchingEngine::Flow;
+      memory = participants.size() * groups.size() * FLOW_BYTES_PER_PAIR;
+    }
+    const double memory_mib = static_cast<double>(memory) / (1 << 20);
+    if (engine == MatchingEngine::Blossom) {
+      TRACE("Estimated memory of the matching: " << std::fixed << std::setprecision(1) << memory_mib
+            << " MiB (blossom with " << sparsified_edges_base << " + log(capacity) edges per group).", top_level);
+    } else {
+      TRACE("Estimated memory of the matching: " << std::fixed << std::setprecision(1) << memory_mib << " MiB ("
+            << (engine == MatchingEngine::Flow ? "flow on participant classes" : "dense assignment") << ").",
+            top_level);
+    }
+    if (engine != requested_engine && config.matching_engine != MatchingEngine::Auto) {
+      WARNING("Matching engine changed to stay below the memory limit of " << config.memory_limit << " MiB.",
+              top_level);
+    }
+    if (memory > limit) {
+      WARNING("Estimated memory of " << std::fixed << std::setprecision(1) << memory_mib << " MiB exceeds the memory limit of "
+              << config.memory_limit << " MiB.", top_level);
     }
   }
-  if (first_participant < num_vertices - first_participant) {
-    FATAL_ERROR("Not enough capacity available: " << (num_vertices - first_participant)
-                << " participants, but only " << first_participant << " group vertices!");
+
+  if (engine == MatchingEngine::Flow) {
+    return calculateClassFlowAssignment(s, top_level, participants, groups, first_group_vertex, slot_bonus,
+                                        assignment, total_weight);
   }
 
-  Graph g(num_vertices);
-  std::vector<GraphTraits::vertex_descriptor> mates(num_vertices);
+  const bool dense = (engine == MatchingEngine::Lapjv);
+  const bool sparsify = config.edge_sparsification && !dense;
+  std::vector<int64_t>& dense_costs = workspace.dense_costs;
+  constexpr int64_t NO_EDGE = std::numeric_limits<int64_t>::max();
+  int64_t max_weight = 0;
+  if (dense) {
+    dense_costs.assign(participants.size() * num_slots, NO_EDGE);
+  }
+  Graph g(dense ? 0 : num_vertices);
 
   // add edges
+  const Rating min_rating_of_groups = Rating::minRating(s.numGroups());
   for (ParticipantID i = 0; i < participants.size(); ++i) {
     const ParticipantID &part = participants[i];
     ASSERT(!s.isAssigned(part));
     double factor = getFactor(s, part);
-    GroupID num_available_groups = 0;
-    for (GroupID group = 0; group < s.numGroups(); ++group) {
-      bool validTeam = s.isTeam(part) &&
-                       combinationIsValid(s.teamData(part), s.groupData(group),
-                                          s.data().students);
-      bool validStudent =
-          !s.isTeam(part) &&
-          combinationIsValid(s.studentData(part), s.groupData(group));
-      if (!s.isExludedFromGroup(part, group) && (validTeam || validStudent)) {
-        ++num_available_groups;
-        uint32_t min_rating = ceil(factor * s.rating(part).at(group).getValue(s.numGroups()));
-        uint32_t max_rating = min_rating + Config::get().min_group_size_effect;
-        GroupID capacity = first_group_vertex[group + 1] - first_group_vertex[group];
-        GroupID min_size = s.groupMinSize(group);
-        double step_factor = std::pow(static_cast<double>(capacity) / static_cast<double>(min_size),
-                                      1.0 / Config::get().min_group_size_effect);
-        uint32_t current_rating = max_rating;
-        double current_target = min_size;
-
-        if (Config::get().edge_sparsification && !restart
-            && s.rating(part).at(group) == Rating::minRating(s.numGroups())) {
-          continue;
-        }
-        std::vector<GroupID> target_slots_within_group;
-        if (Config::get().edge_sparsification) {
-          GroupID num_edges = computeNumberOfGeneratedEdges(capacity);
-          if (num_edges + 2 < capacity) {
-            target_slots_within_group = createRandomSubsetOfIDs(gen, num_edges, capacity);
-          }
-        }
+    forEachValidGroup(s, part, groups, [&](GroupID k, Rating rating) {
+      const uint32_t min_rating = baseEdgeWeight(s, part, groups[k], rating, factor);
+      const GroupID capacity = first_group_vertex[k + 1] - first_group_vertex[k];
 
+      const GraphTraits::vertex_descriptor first_vertex = first_group_vertex[k];
+      if (dense) {
+        int64_t* row_costs = &dense_costs[i * num_slots + first_vertex];
         for (GroupID j = 0; j < capacity; ++j) {
-          auto vertex = first_group_vertex[group] + j;
-          bool should_add_edge = false;
-          if (target_slots_within_group.empty()) {
-            should_add_edge = true;
-          } else {
-            for (size_t slot = 0; slot < target_slots_within_group.size(); ++slot) {
-              if (target_slots_within_group[slot] == j) {
-                should_add_edge = true;
-                break;
-              }
-            }
-          }
-          if (should_add_edge) {
-            add_edge(vertex, first_participant + i, EdgeProperty(current_rating), g);
-          }
+          const int64_t weight = min_rating + slot_bonus[first_vertex + j];
+          row_costs[j] = -weight;
+          max_weight = std::max(max_weight, weight);
+        }
+        return;
+      }
 
-          // Gradually increase the rating so some of the places in the group are better than others.
-          // This nudges the algorithm to distribute students more evenly among groups, thereby
-          // fullfilling the minimum group sizes
-          if (Config::get().use_min_group_sizes && j + 1.99 >= current_target) {
-            ASSERT(current_rating >= min_rating);
-            ASSERT_WITH(j == 0 || j + 1 < capacity || current_rating == min_rating,
-            "Min group size must be significantly below capacity.");
-            current_target *= step_factor;
-            current_rating--;
-          }
+      if (sparsify && !restart && rating == min_rating_of_groups) {
+        return;
+      }
+      target_slots_within_group.clear();
+      if (sparsify) {
+        GroupID num_edges = computeNumberOfGeneratedEdges(capacity, sparsified_edges_base);
+        if (num_edges + 2 < capacity) {
+          createRandomSubsetOfIDs(gen, num_edges, capacity, target_slots_within_group);
         }
       }
-    }
 
-    const std::string &name =
-        s.isTeam(part) ? s.teamData(part).id : s.studentData(part).name;
-    if (num_available_groups == 0) {
-      ERROR("No group available for participant \"" << name << "\"!\n"
-            "Maybe the group configuration is incorrect (course/degree type)?", top_level);
-      return {{}, false};
-    } else if (num_available_groups == 1) {
-      WARNING("Only one group available for participant \"" << name << "\"!", top_level);
-    }
+      if (target_slots_within_group.empty()) {
+        for (GroupID j = 0; j < capacity; ++j) {
+          add_edge(first_vertex + j, first_participant + i,
+                   EdgeProperty(min_rating + slot_bonus[first_vertex + j]), g);
+        }
+      } else {
+        for (GroupID j : target_slots_within_group) {
+          add_edge(first_vertex + j, first_participant + i,
+                   EdgeProperty(min_rating + slot_bonus[first_vertex + j]), g);
+        }
+      }
+    });
   }
 
   // calculate the matching
   std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+  if (dense) {
+    // a missing edge is more expensive than any assignment with one missing edge less
+    const int64_t missing_cost = (max_weight + 1) * (static_cast<int64_t>(participants.size()) + 1);
+    for (int64_t& cost : dense_costs) {
+      cost = (cost == NO_EDGE) ? missing_cost : cost;
+    }
+    const std::vector<uint32_t> slot_of_participant =
+        solveLinearAssignment(dense_costs, participants.size(), num_slots);
+    if (slot_of_participant.empty()) {
+      ERROR("Interrupted (SIGINT or time limit).", true);
+      return false;
+    }
 
-  // call graph algorithm in separate thread so it is interruptible
-  finished.store(false);
-  std::thread algo_thread([&] {
-    auto local_graph = std::move(g);
-    auto local_mates = std::move(mates);
-    maximum_weighted_matching(local_graph, &local_mates[0]);
-    if (!interrupted.load()) {
-      g = std::move(local_graph);
-      mates = std::move(local_mates);
-      finished.store(true);
+    bool success = true;
+    ParticipantID num_assigned = 0;
+    total_weight = 0;
+    for (ParticipantID i = 0; i < participants.size(); ++i) {
+      const ParticipantID part = participants[i];
+      const uint32_t slot = slot_of_participant[i];
+      const int64_t cost = dense_costs[i * num_slots + slot];
+      if (cost != missing_cost) {
+        assignment[part] = vertex_to_group[slot];
+        total_weight -= cost;
+        ++num_assigned;
+      } else {
+        const std::string &name =
+            s.isTeam(part) ? s.teamData(part).id : s.studentData(part).name;
+        ERROR("Participant \"" << name << "\" not assigned!", top_level);
+        success = false;
+      }
     }
+    MAJOR_PROGRESS("Assignment with size " << num_assigned
+                   << " and total weight " << total_weight
+                   << " calculated ("
+                   << std::chrono::duration<double>(std::chrono::system_clock::now() - start).count()
+                   << " s).", top_level);
+    return success;
+  }
+  std::vector<GraphTraits::vertex_descriptor> mates = std::move(workspace.mates);
+  mates.assign(num_vertices, GraphTraits::vertex_descriptor());
+
+  // Call graph algorithm in a separate (detached) thread so it is interruptible. It must not run as pool
+  // task, since a waiting worker might execute it inline. The waiting thread doesn't execute other tasks,
+  // so there are at most as many matchings running as threads are waiting for them.
+  auto computation = std::make_shared<MatchingComputation>();
+  computation->graph = std::move(g);
+  computation->mates = std::move(mates);
+  std::thread algo_thread([computation] {
+    maximum_weighted_matching(computation->graph, &computation->mates[0]);
+    computation->finished.store(true);
   });
   algo_thread.detach();
+  while (!computation->finished.load() && !cancellationRequested()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  if (!computation->finished.load()) {
+    ERROR("Interrupted (SIGINT or time limit).", true);
+    return false;
+  }
+  g = std::move(computation->graph);
+  mates = std::move(computation->mates);
 
-  do {
-    if (interrupted.load()) {
-      ERROR("SIGINT received. Interrupting...", true);
-      return {{}, false};
-    }
-    std::this_thread::yield();
-  } while (!finished.load());
-
+  total_weight = matching_weight_sum(g, &mates[0]);
   MAJOR_PROGRESS("Matching with size " << matching_size(g, &mates[0])
-                 << " and total weight " << matching_weight_sum(g, &mates[0])
+                 << " and total weight " << total_weight
                  << " calculated ("
                  << std::chrono::duration<double>(std::chrono::system_clock::now() - start).count()
                  << " s).", top_level);
 
+  // participants that are only unmatched due to the sparsification are inserted with their missing edges
+  std::vector<ParticipantID> unmatched;
+  for (ParticipantID i = 0; i < participants.size(); ++i) {
+    if (mates[first_participant + i] == GraphTraits::null_vertex()) {
+      unmatched.push_back(i);
+    }
+  }
+  if (sparsify && !restart && !unmatched.empty()) {
+    std::vector<GraphTraits::vertex_descriptor> repaired_mates = mates;
+    int64_t repaired_weight = total_weight;
+    if (repairSparsifiedMatching(s, participants, groups, first_group_vertex, slot_bonus, unmatched,
+                                 repaired_mates, repaired_weight)) {
+      PROGRESS("Inserted " << unmatched.size() << " unmatched participants, total weight "
+               << repaired_weight << ".", top_level);
+      mates = std::move(repaired_mates);
+      total_weight = repaired_weight;
+    }
+  }
+
   // translate the matching to an assignment
-  std::vector<int32_t> assignment(s.numParticipants(), -1);
   GraphTraits::vertex_iterator vi, vi_end;
   boost::tie(vi, vi_end) = vertices(g);
 
@@ -281,13 +743,221 @@ std::pair<std::vector<int32_t>, bool> calculateAssignmentImpl(const State &s, st
     }
     ++part_idx;
   }
+  workspace.mates = std::move(mates);
+  return success;
+}
+
+std::pair<std::vector<int32_t>, bool> calculateAssignmentImpl(const State &s, std::mt19937_64& gen, bool top_level, bool restart) {
+  std::vector<ParticipantID> participants;
+  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+    if (!s.isAssigned(part)) {
+      participants.push_back(part);
+    }
+  }
+  std::vector<GroupID> groups;
+  size_t num_slots = 0;
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    if (s.groupIsEnabled(group)) {
+      groups.push_back(group);
+      num_slots += s.groupCapacity(group);
+    }
+  }
+  if (num_slots < participants.size()) {
+    FATAL_ERROR("Not enough capacity available: " << participants.size()
+                << " participants, but only " << num_slots << " group vertices!");
+  }
+
+  // groups with free slots are connected by the participants which can be assigned to both
+  constexpr GroupID NO_GROUP = std::numeric_limits<GroupID>::max();
+  std::vector<GroupID> parent(s.numGroups());
+  std::iota(parent.begin(), parent.end(), 0);
+  auto find_root = [&](GroupID group) {
+    while (parent[group] != group) {
+      parent[group] = parent[parent[group]];
+      group = parent[group];
+    }
+    return group;
+  };
+  std::vector<GroupID> first_group_of(participants.size(), NO_GROUP);
+  bool all_connected = true;
+  for (ParticipantID i = 0; i < participants.size(); ++i) {
+    const ParticipantID part = participants[i];
+    GroupID num_available_groups = 0;
+    for (const auto [group, rating] : s.rating(part)) {
+      if (rating.isValid() && !s.isExludedFromGroup(part, group) && combinationIsValid(s, part, group)) {
+        ++num_available_groups;
+        if (!s.groupIsEnabled(group) || s.groupCapacity(group) == 0) {
+          continue;
+        } else if (first_group_of[i] == NO_GROUP) {
+          first_group_of[i] = group;
+        } else {
+          parent[find_root(group)] = find_root(first_group_of[i]);
+        }
+      }
+    }
+    all_connected &= (first_group_of[i] != NO_GROUP);
+
+    const std::string &name =
+        s.isTeam(part) ? s.teamData(part).id : s.studentData(part).name;
+    if (num_available_groups == 0) {
+      ERROR("No group available for participant \"" << name << "\"!\n"
+            "Maybe the group configuration is incorrect (course/degree type)?", top_level);
+      return {{}, false};
+    } else if (num_available_groups == 1) {
+      WARNING("Only one group available for participant \"" << name << "\"!", top_level);
+    }
+  }
+
+  // collect the connected components which contain participants
+  std::vector<uint32_t> component_of_root(s.numGroups(), NO_GROUP);
+  std::vector<std::vector<ParticipantID>> component_participants;
+  std::vector<std::vector<GroupID>> component_groups;
+  if (all_connected) {
+    for (ParticipantID i = 0; i < participants.size(); ++i) {
+      const GroupID root = find_root(first_group_of[i]);
+      if (component_of_root[root] == NO_GROUP) {
+        component_of_root[root] = component_participants.size();
+        component_participants.emplace_back();
+      }
+      component_participants[component_of_root[root]].push_back(participants[i]);
+    }
+  }
+
+  std::vector<int32_t> assignment(s.numParticipants(), -1);
+  if (component_participants.size() <= 1) {
+    int64_t total_weight;
+    const bool success = calculateComponentAssignment(s, gen, top_level, restart, participants, groups,
+                                                      assignment, total_weight);
+    return {std::move(assignment), success};
+  }
+
+  // independent components are solved in parallel, each with its own random generator
+  std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+  const size_t num_components = component_participants.size();
+  component_groups.resize(num_components);
+  for (GroupID group : groups) {
+    const uint32_t component = component_of_root[find_root(group)];
+    if (component != NO_GROUP) {
+      component_groups[component].push_back(group);
+    }
+  }
+  std::vector<std::mt19937_64> generators;
+  for (size_t c = 0; c < num_components; ++c) {
+    generators.emplace_back(gen());
+  }
+  std::vector<char> component_success(num_components, false);
+  std::vector<int64_t> component_weight(num_components, 0);
+  TaskGroup tasks;
+  for (size_t c = 0; c < num_components; ++c) {
+    tasks.run([&, c] {
+      component_success[c] = calculateComponentAssignment(s, generators[c], false, restart,
+                                                          component_participants[c], component_groups[c],
+                                                          assignment, component_weight[c]);
+    });
+  }
+  if (!tasks.wait()) {
+    ERROR("Interrupted (SIGINT or time limit).", true);
+    return {{}, false};
+  }
+
+  const bool success = std::all_of(component_success.begin(), component_success.end(),
+                                   [](char component_ok) { return component_ok; });
+  const ParticipantID num_assigned = std::count_if(assignment.begin(), assignment.end(),
+                                                   [](int32_t group) { return group >= 0; });
+  MAJOR_PROGRESS("Matching with size " << num_assigned
+                 << " and total weight " << std::accumulate(component_weight.begin(), component_weight.end(), int64_t(0))
+                 << " calculated from " << num_components << " independent components ("
+                 << std::chrono::duration<double>(std::chrono::system_clock::now() - start).count()
+                 << " s).", top_level);
   return {std::move(assignment), success};
 }
 
 
-std::pair<std::vector<int32_t>, bool> calculateAssignment(const State &s, std::mt19937_64& gen, bool top_level) {
+FeasibilityCertificate checkAssignmentFeasibility(const State &s, bool team_sizes) {
+  // source -> participant (demand) -> valid group (unbounded) -> sink (free capacity)
+  const ParticipantID num_participants = s.numParticipants();
+  const size_t source = num_participants + s.numGroups();
+  const size_t sink = source + 1;
+  MaxFlow flow(sink + 1);
+  int64_t total_demand = 0;
+  for (ParticipantID part = 0; part < num_participants; ++part) {
+    if (s.isAssigned(part)) {
+      continue;
+    }
+    const int64_t demand = (team_sizes && s.isTeam(part)) ? s.teamData(part).size() : 1;
+    total_demand += demand;
+    flow.addArc(source, part, demand);
+    for (const auto [group, rating] : s.rating(part)) {
+      if (rating.isValid() && s.groupIsEnabled(group) && s.groupCapacity(group) > 0
+          && !s.isExludedFromGroup(part, group) && combinationIsValid(s, part, group)) {
+        flow.addArc(part, num_participants + group, demand);
+      }
+    }
+  }
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    if (s.groupIsEnabled(group)) {
+      flow.addArc(num_participants + group, sink, s.groupCapacity(group));
+    }
+  }
+
+  FeasibilityCertificate result;
+  if (flow.solve(source, sink) == total_demand) {
+    return result;
+  }
+  // the source side of the minimum cut violates Hall's condition
+  result.feasible = false;
+  const std::vector<bool> source_side = flow.sourceSide(source);
+  for (ParticipantID part = 0; part < num_participants; ++part) {
+    if (source_side[part]) {
+      result.participants.push_back(part);
+    }
+  }
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    if (source_side[num_participants + group]) {
+      result.groups.push_back(group);
+    }
+  }
+  return result;
+}
+
+void printInfeasibility(const State &s, const FeasibilityCertificate& certificate, bool top_level) {
+  constexpr size_t MAX_LISTED = 5;
+  std::ostringstream names;
+  for (size_t i = 0; i < std::min(certificate.participants.size(), MAX_LISTED); ++i) {
+    const ParticipantID part = certificate.participants[i];
+    names << (i > 0 ? ", " : "") << "\"" << (s.isTeam(part) ? s.teamData(part).id : s.studentData(part).name) << "\"";
+  }
+  if (certificate.participants.size() > MAX_LISTED) {
+    names << ", ...";
+  }
+  StudentID capacity = 0;
+  std::ostringstream groups;
+  for (size_t i = 0; i < certificate.groups.size(); ++i) {
+    capacity += s.groupCapacity(certificate.groups[i]);
+    if (i < MAX_LISTED) {
+      groups << (i > 0 ? ", " : "") << "\"" << s.groupData(certificate.groups[i]).name << "\"";
+    }
+  }
+  if (certificate.groups.size() > MAX_LISTED) {
+    groups << ", ...";
+  }
+  ERROR("No feasible assignment: " << certificate.participants.size() << " participants (" << names.str()
+        << ") can only be assigned to " << certificate.groups.size() << " groups (" << groups.str()
+        << ") with " << capacity << " free places.", top_level);
+}
+
+std::pair<std::vector<int32_t>, bool> calculateAssignment(const State &s, std::mt19937_64& gen, bool top_level,
+                                                          bool check_feasibility) {
+  // rejects infeasible states before the weighted matching (and its restart) is calculated
+  if (check_feasibility) {
+    const FeasibilityCertificate certificate = checkAssignmentFeasibility(s, false);
+    if (!certificate.feasible) {
+      printInfeasibility(s, certificate, top_level);
+      return {{}, false};
+    }
+  }
   auto [result, success] = calculateAssignmentImpl(s, gen, top_level, false);
-  if (!success && !interrupted.load() && Config::get().edge_sparsification) {
+  if (!success && !cancellationRequested() && Config::get().edge_sparsification) {
     INFO("Restarting assignment with included low rated edges.", top_level);
     return calculateAssignmentImpl(s, gen, top_level, true);
   }
@@ -358,12 +1028,80 @@ preassignLargeTeams(State &s, const std::vector<int32_t> &assignment, bool top_l
   return modified_groups;
 }
 
+ParticipantID numUnassignedTeams(const State &s) {
+  ParticipantID num = 0;
+  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+    if (s.isTeam(part) && !s.isAssigned(part)) {
+      ++num;
+    }
+  }
+  return num;
+}
+
+// If only few places are free (e.g. in a partially filled state), the matching might place the teams only
+// in groups where they don't fit. Then, the largest team is assigned to its best group with enough space.
+bool preassignLargestTeam(State &s, bool top_level) {
+  std::optional<ParticipantID> largest;
+  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+    if (s.isTeam(part) && !s.isAssigned(part)
+        && (!largest || s.teamData(part).size() > s.teamData(*largest).size())) {
+      largest = part;
+    }
+  }
+  if (!largest) {
+    return false;
+  }
+  std::optional<GroupID> best;
+  uint32_t best_weight = 0;
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    if (s.groupIsEnabled(group) && s.groupCapacity(group) >= s.teamData(*largest).size()
+        && !s.isExludedFromGroup(*largest, group) && combinationIsValid(s, *largest, group)) {
+      const uint32_t weight = baseEdgeWeight(s, *largest, group, getFactor(s, *largest));
+      if (!best || weight > best_weight) {
+        best = group;
+        best_weight = weight;
+      }
+    }
+  }
+  if (!best) {
+    return false;
+  }
+  TRACE("Preassign team \"" << s.teamData(*largest).id << "\" to group \"" << s.groupData(*best).name
+        << "\" with enough free places.", top_level);
+  return s.assignParticipant(*largest, *best);
+}
+
 bool assignTeamsAndStudents(State &s, bool top_level) {
   s.reset();
-  StudentID num_students = s.data().students.size();
+  return assignRemainingParticipants(s, top_level);
+}
+
+bool assignRemainingParticipants(State &s, bool top_level) {
+  StudentID num_students = 0;
+  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+    if (!s.isAssigned(part)) {
+      num_students += s.isTeam(part) ? s.teamData(part).size() : 1;
+    }
+  }
+  if (num_students == 0) {
+    return true;
+  }
+  // Rejects the candidate state before any matching. Since a team can use any of its slots, the check also
+  // covers the matchings with one slot per participant as long as no team is assigned and the capacities
+  // are not reduced, so these skip their own check.
+  const FeasibilityCertificate certificate = checkAssignmentFeasibility(s, true);
+  if (!certificate.feasible) {
+    printInfeasibility(s, certificate, top_level);
+    return false;
+  }
+  const ParticipantID num_unassigned_teams = numUnassignedTeams(s);
+  // in a partially filled state (e.g. a warm start), only the free places are counted
   StudentID activeCapacity = s.totalActiveGroupCapacity();
   StudentID initial_capacity = 0;
-  ASSERT(activeCapacity > num_students);
+  if (activeCapacity <= num_students) {
+    ERROR("Not enough free capacity for " << num_students << " students.", top_level);
+    return false;
+  }
   for (GroupID group = 0; group < s.numGroups(); ++group) {
     initial_capacity = std::max(initial_capacity, s.groupCapacity(group));
   }
@@ -383,8 +1121,8 @@ bool assignTeamsAndStudents(State &s, bool top_level) {
     double mod_reduced_factor =
         static_cast<double>(activeCapacity + total_reduced) /
         static_cast<double>(activeCapacity);
-    double reduction_factor = team_factor * mod_reduced_factor;
-    ASSERT(reduction_factor <= 1);
+    // after preassigning teams, the correction can exceed 1 if only few places are free
+    double reduction_factor = std::min(1.0, team_factor * mod_reduced_factor);
     TRACE("Relative capacity for team assignment set to " << reduction_factor << ".", top_level);
 
     State s_temp(s);
@@ -394,7 +1132,8 @@ bool assignTeamsAndStudents(State &s, bool top_level) {
             << new_capacity << " (instead of " << s_temp.groupCapacity(group) << ")");
       s_temp.setCapacity(group, ceil(reduction_factor * s_temp.groupCapacity(group)));
     }
-    auto [assignment, success_first_step] = calculateAssignment(s_temp, s.getRandomness(), top_level);
+    const bool checked = (reduction_factor == 1.0 && numUnassignedTeams(s) == num_unassigned_teams);
+    auto [assignment, success_first_step] = calculateAssignment(s_temp, s.getRandomness(), top_level, !checked);
     if (!success_first_step) {
       ERROR("Team assignment failed. Canceling.", top_level);
       return false;
@@ -403,13 +1142,19 @@ bool assignTeamsAndStudents(State &s, bool top_level) {
     if (!success) {
       WARNING("Team assignment not successful due to exceeded "
               "capacity. Assign single teams and retry.", top_level);
+      const ParticipantID num_unassigned = numUnassignedTeams(s);
       std::vector<GroupID> modified_groups = preassignLargeTeams(s, assignment, top_level);
       total_reduced += modified_groups.size();
+      if (numUnassignedTeams(s) == num_unassigned && !preassignLargestTeam(s, top_level)) {
+        ERROR("Could not preassign any team. Canceling.", top_level);
+        return false;
+      }
     }
   } while (!success);
 
   TRACE("Team assignment successful.", top_level);
-  auto [assignment, success_final] = calculateAssignment(s, s.getRandomness(), top_level);
+  auto [assignment, success_final] = calculateAssignment(s, s.getRandomness(), top_level,
+                                                         numUnassignedTeams(s) != num_unassigned_teams);
   success = success_final && applyAssignment(s, assignment);
   if (success) {
     PROGRESS("Current assignment completed.", top_level);
@@ -418,13 +1163,329 @@ bool assignTeamsAndStudents(State &s, bool top_level) {
   return success;
 }
 
+ParticipantID keepPreviousAssignment(State &s) {
+  // groups that were disabled previously stay disabled, so that no new small groups are created
+  std::vector<bool> previously_used(s.numGroups(), false);
+  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+    if (s.previousGroup(part) >= 0) {
+      previously_used[s.previousGroup(part)] = true;
+    }
+  }
+  StudentID used_capacity = 0;
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    if (previously_used[group] && s.groupIsEnabled(group)) {
+      used_capacity += s.groupCapacity(group);
+    }
+  }
+  if (used_capacity > s.numStudents()) {
+    for (GroupID group = 0; group < s.numGroups(); ++group) {
+      if (!previously_used[group] && s.groupIsEnabled(group)) {
+        TRACE("Group \"" << s.groupData(group).name << "\" stays disabled.", true);
+        s.disableGroup(group);
+      }
+    }
+  }
+
+  ParticipantID num_kept = 0;
+  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+    const int32_t group = s.previousGroup(part);
+    if (!s.isAssigned(part) && group >= 0 && s.groupIsEnabled(group) && !s.isExludedFromGroup(part, group)
+        && combinationIsValid(s, part, group) && s.assignParticipant(part, group)) {
+      ++num_kept;
+    }
+  }
+  return num_kept;
+}
+
+// Each participant is distributed over its available groups, where the share decays exponentially
+// with the difference of the rating value to its best group. Afterwards, the shares of overfull groups
+// are scaled down until the demand fits the capacities. All loops run over a flat participant x group
+// matrix without branches, so they can be vectorized.
+std::vector<double> computeGroupDemand(const State &s) {
+  // in units of rating values, i.e. the second best rating has a relative weight of exp(-1 / 2)
+  constexpr double temperature = 2.0;
+  constexpr uint32_t max_capacity_iterations = 50;
+  const GroupID num_groups = s.numGroups();
+  const ParticipantID num_participants = s.numParticipants();
+
+  std::vector<double> shares(static_cast<size_t>(num_participants) * num_groups, 0.0);
+  std::vector<double> sizes(num_participants, 0.0);
+  std::vector<double> values(num_groups, 0.0);
+  std::vector<double> mask(num_groups, 0.0);
+  for (ParticipantID part = 0; part < num_participants; ++part) {
+    for (const auto [group, rating] : s.rating(part)) {
+      values[group] = rating.getValue(num_groups);
+      mask[group] = (s.groupIsEnabled(group) && combinationIsValid(s, part, group)) ? 1.0 : 0.0;
+    }
+    double best_value = 0;
+    for (GroupID group = 0; group < num_groups; ++group) {
+      best_value = std::max(best_value, mask[group] * values[group]);
+    }
+    double* row = &shares[static_cast<size_t>(part) * num_groups];
+    for (GroupID group = 0; group < num_groups; ++group) {
+      row[group] = mask[group] * std::exp(std::min(0.0, values[group] - best_value) / temperature);
+    }
+    sizes[part] = s.isTeam(part) ? s.teamData(part).size() : 1;
+  }
+
+  std::vector<double> capacities(num_groups, 0.0);
+  for (GroupID group = 0; group < num_groups; ++group) {
+    capacities[group] = s.groupData(group).capacity;
+  }
+  std::vector<double> scale(num_groups, 1.0);
+  std::vector<double> demand(num_groups, 0.0);
+  for (uint32_t iteration = 0; iteration < max_capacity_iterations; ++iteration) {
+    std::fill(demand.begin(), demand.end(), 0.0);
+    for (ParticipantID part = 0; part < num_participants; ++part) {
+      const double* row = &shares[static_cast<size_t>(part) * num_groups];
+      double total = 0;
+      for (GroupID group = 0; group < num_groups; ++group) {
+        total += row[group] * scale[group];
+      }
+      const double factor = (total > 0) ? sizes[part] / total : 0.0;
+      for (GroupID group = 0; group < num_groups; ++group) {
+        demand[group] += factor * row[group] * scale[group];
+      }
+    }
+    bool overfull = false;
+    for (GroupID group = 0; group < num_groups; ++group) {
+      if (demand[group] > capacities[group] + 0.5) {
+        scale[group] *= capacities[group] / demand[group];
+        overfull = true;
+      }
+    }
+    if (!overfull) {
+      break;
+    }
+  }
+  return demand;
+}
+
+// Disables groups that are hopeless according to their demand, before any assignment is calculated
+void predisableGroupsByDemand(State &s, StudentID min_capacity, StudentID& active_capacity) {
+  const double threshold = Config::get().demand_predisable_factor * min_capacity;
+  const StudentID required_capacity = ceil(Config::get().capacity_buffer * s.data().students.size());
+  const std::vector<double> demand = computeGroupDemand(s);
+  std::vector<GroupID> order;
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    if (s.groupIsEnabled(group) && demand[group] < threshold) {
+      order.push_back(group);
+    }
+  }
+  std::sort(order.begin(), order.end(), [&](GroupID g1, GroupID g2) {
+    return demand[g1] < demand[g2];
+  });
+  for (GroupID group : order) {
+    const StudentID capacity = s.groupData(group).capacity;
+    if (active_capacity - capacity >= required_capacity) {
+      MAJOR_TRACE("Disable group \"" << s.groupData(group).name << "\" (expected demand "
+                  << demand[group] << ").", true);
+      s.disableGroup(group);
+      active_capacity -= capacity;
+    }
+  }
+}
+
+// Disables all groups that are predicted to stay below the minimum at once. The prediction moves the
+// students of each disabled group (lowest demand first) to their best remaining group, which might lift
+// other small groups above the minimum. The result is verified with a single solve, if this fails the
+// number of disabled groups is halved.
+bool disableGroupsInBulk(State &s, StudentID min_capacity, StudentID& active_capacity) {
+  const std::vector<double> demand = computeGroupDemand(s);
+  const StudentID required_capacity = ceil(Config::get().capacity_buffer * s.data().students.size());
+  std::vector<GroupID> candidates;
+  std::vector<StudentID> predicted_size(s.numGroups(), 0);
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    predicted_size[group] = s.groupSize(group);
+    if (s.groupIsEnabled(group) && s.groupSize(group) < min_capacity) {
+      candidates.push_back(group);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(), [&](GroupID g1, GroupID g2) {
+    return demand[g1] < demand[g2] || (demand[g1] == demand[g2] && s.groupWeight(g1) < s.groupWeight(g2));
+  });
+
+  std::vector<GroupID> to_disable;
+  std::vector<bool> is_disabled(s.numGroups(), false);
+  StudentID predicted_capacity = active_capacity;
+  for (GroupID group : candidates) {
+    const StudentID capacity = s.groupData(group).capacity;
+    if (predicted_size[group] >= min_capacity || predicted_capacity - capacity < required_capacity) {
+      continue;
+    }
+    to_disable.push_back(group);
+    is_disabled[group] = true;
+    predicted_capacity -= capacity;
+    for (const auto& [student, part] : s.groupAssignmentList(group)) {
+      GroupID best = s.numGroups();
+      for (GroupID target = 0; target < s.numGroups(); ++target) {
+        if (s.groupIsEnabled(target) && !is_disabled[target] && predicted_size[target] < s.groupData(target).capacity
+            && combinationIsValid(s, part, target) && !s.isExludedFromGroup(part, target)
+            && (best == s.numGroups() || s.rating(part).at(target).index < s.rating(part).at(best).index)) {
+          best = target;
+        }
+      }
+      if (best < s.numGroups()) {
+        predicted_size[best]++;
+      }
+    }
+  }
+  if (to_disable.empty()) {
+    return false;
+  }
+
+  for (size_t num = to_disable.size(); num > 0 && !cancellationRequested(); num /= 2) {
+    MAJOR_TRACE("Disabling " << num << " groups predicted to stay below " << min_capacity << " students.", true);
+    State s_temp(s);
+    StudentID new_capacity = active_capacity;
+    for (size_t i = 0; i < num; ++i) {
+      DEBUG("Disable group \"" << s.groupData(to_disable[i]).name << "\" (demand " << demand[to_disable[i]] << ").");
+      s_temp.disableGroup(to_disable[i]);
+      new_capacity -= s.groupData(to_disable[i]).capacity;
+    }
+    if (assignTeamsAndStudents(s_temp, true)) {
+      s = s_temp;
+      active_capacity = new_capacity;
+      return true;
+    }
+    WARNING("Could not calculate assignment with " << num << " disabled groups. Backtracking.", true);
+  }
+  return false;
+}
+
+// Candidate sets of groups to disable, where the groups are disabled in the given order as long as the
+// capacity buffer allows it. The first candidate is the default, each further candidate spares one group.
+std::vector<std::vector<GroupID>> disablingCandidates(const State &s, const std::vector<GroupID>& groups,
+                                                      StudentID active_capacity, uint32_t max_candidates) {
+  const StudentID required_capacity = ceil(Config::get().capacity_buffer * s.data().students.size());
+  std::vector<std::vector<GroupID>> result;
+  for (size_t spared = 0; spared <= groups.size() && result.size() < max_candidates; ++spared) {
+    std::vector<GroupID> disabled;
+    StudentID capacity = active_capacity;
+    for (size_t i = 0; i < groups.size(); ++i) {
+      const StudentID group_capacity = s.groupData(groups[i]).capacity;
+      if (i + 1 != spared && capacity - group_capacity >= required_capacity) {
+        disabled.push_back(groups[i]);
+        capacity -= group_capacity;
+      }
+    }
+    if (!disabled.empty() && std::find(result.begin(), result.end(), disabled) == result.end()) {
+      result.push_back(std::move(disabled));
+    }
+  }
+  return result;
+}
+
+// Calculates an assignment for each variant in parallel, each on its own copy of the state with its own
+// random generator. A variant is created by calling `modify(state, index)`. Returns the index and state
+// of the best variant according to `better(state_1, state_2)`, if any calculation succeeded.
+template<typename Modify, typename Better>
+std::optional<std::pair<size_t, State>> evaluateVariantsInParallel(State &s, size_t num_variants,
+                                                                   Modify modify, Better better) {
+  std::mt19937_64& random_gen = s.getRandomness();
+  std::vector<std::mt19937_64> generators;
+  for (size_t i = 0; i < num_variants; ++i) {
+    generators.emplace_back(random_gen());
+  }
+
+  std::vector<std::optional<State>> results(num_variants);
+  TaskGroup tasks;
+  for (size_t i = 0; i < num_variants; ++i) {
+    tasks.run([&, i] {
+      State s_variant(s);
+      s_variant.setRandomness(generators[i]);
+      modify(s_variant, i);
+      if (assignTeamsAndStudents(s_variant, false)) {
+        results[i] = std::move(s_variant);
+      }
+    });
+  }
+  if (!tasks.wait()) {
+    return std::nullopt;
+  }
+
+  std::optional<size_t> best;
+  for (size_t i = 0; i < num_variants; ++i) {
+    if (results[i]) {
+      TRACE("Variant " << i << " calculated with total weight " << totalWeight(*results[i]) << ".", true);
+      if (!best || better(*results[i], *results[*best])) {
+        best = i;
+      }
+    } else {
+      TRACE("Variant " << i << " failed.", true);
+    }
+  }
+  if (!best) {
+    return std::nullopt;
+  }
+  State& result = *results[*best];
+  result.setRandomness(random_gen);
+  return std::make_pair(*best, std::move(result));
+}
+
+// Chooses the best candidate for disabling groups: fewest groups below the allowed minimum, then highest weight
+std::optional<std::pair<size_t, State>> evaluateDisablingCandidates(State &s,
+    const std::vector<std::vector<GroupID>>& candidates, StudentID allowed_min) {
+  MAJOR_TRACE("Evaluating " << candidates.size() << " candidates for disabling groups in parallel.", true);
+  auto num_too_small = [&](const State& state) {
+    StudentID result = 0;
+    for (GroupID group = 0; group < state.numGroups(); ++group) {
+      if (state.groupIsEnabled(group) && state.groupSize(group) < allowed_min) {
+        ++result;
+      }
+    }
+    return result;
+  };
+  return evaluateVariantsInParallel(s, candidates.size(),
+    [&](State& variant, size_t i) {
+      for (GroupID group : candidates[i]) {
+        variant.disableGroup(group);
+      }
+    },
+    [&](const State& s1, const State& s2) {
+      return num_too_small(s1) < num_too_small(s2)
+             || (num_too_small(s1) == num_too_small(s2) && totalWeight(s1) > totalWeight(s2));
+    });
+}
+
+// budget of the flow fallback if the time limit is reached before the initial assignment
+constexpr double FALLBACK_TIME_SHARE = 0.5;
+constexpr double MIN_FALLBACK_SECONDS = 1;
+
+// reason why an outer loop keeps its current assignment instead of calculating the next step
+void reportFallback(const char* message) {
+  if (cancellationRequested()) {
+    WARNING("Calculation stopped. Keeping the best assignment so far.", true);
+  } else {
+    ERROR(message, true);
+  }
+}
+
 // Top level function that calculates an assignment with a specified minimum capacity for the groups
-void assignWithMinimumNumberPerGroup(State &s, StudentID min_capacity) {
+bool assignWithMinimumNumberPerGroup(State &s, StudentID min_capacity) {
   StudentID allowed_min = 1;
   StudentID active_capacity = s.totalActiveGroupCapacity();
-  const bool success_initial = assignTeamsAndStudents(s, true);
+  if (Config::get().demand_predisable_factor > 0) {
+    predisableGroupsByDemand(s, min_capacity, active_capacity);
+  }
+  bool success_initial = assignTeamsAndStudents(s, true);
+  if (!success_initial && deadlineReached() && !interruptRequested()) {
+    // the flow on participant classes is fast enough to still provide a result within an own budget
+    WARNING("Time limit reached before the initial assignment. Calculating it via flow.", true);
+    Config flow_options = Config::get();
+    flow_options.matching_engine = MatchingEngine::Flow;
+    Config::Scope config_scope(&flow_options);
+    DeadlineScope deadline_scope(deadlineAfter(std::max(MIN_FALLBACK_SECONDS,
+                                                        FALLBACK_TIME_SHARE * Config::get().time_limit)));
+    success_initial = assignTeamsAndStudents(s, true);
+  }
   if (!success_initial) {
-    FATAL_ERROR("Could not calculate an initial assignment.");
+    ERROR("Could not calculate an initial assignment.", true);
+    return false;
+  }
+  // the incremental loop handles any remaining groups below the minimum
+  if (Config::get().group_disable_strategy == GroupDisableStrategy::Bulk) {
+    disableGroupsInBulk(s, min_capacity, active_capacity);
   }
   while (true) {
     StudentID current_min = std::numeric_limits<StudentID>::max();
@@ -449,21 +1510,31 @@ void assignWithMinimumNumberPerGroup(State &s, StudentID min_capacity) {
                 [&](GroupID g1, GroupID g2) {
                   return s.groupWeight(g1) < s.groupWeight(g2);
                 });
-      bool removed = false;
-      for (GroupID group : groups_to_remove) {
-        StudentID capacity = s.groupData(group).capacity;
-        if (active_capacity - capacity >=
-            ceil(Config::get().capacity_buffer * s.data().students.size())) {
+      std::vector<std::vector<GroupID>> candidates = disablingCandidates(
+          s, groups_to_remove, active_capacity, Config::get().speculative_candidates);
+      if (candidates.empty()) {
+        INFO("No further group could be removed. Stopping.", true);
+        break;
+      }
+      if (candidates.size() > 1) {
+        auto result = evaluateDisablingCandidates(s, candidates, allowed_min);
+        if (!result) {
+          reportFallback("Could not calculate assignment. Falling back to previous solution.");
+          break;
+        }
+        for (GroupID group : candidates[result->first]) {
           MAJOR_TRACE("Disable group \"" << s.groupData(group).name << "\" ("
                       << s.groupSize(group) << " participants).", true);
-          s.disableGroup(group);
-          active_capacity -= capacity;
-          removed = true;
+          active_capacity -= s.groupData(group).capacity;
         }
+        s = std::move(result->second);
+        continue;
       }
-      if (!removed) {
-        INFO("No further group could be removed. Stopping.", true);
-        break;
+      for (GroupID group : candidates[0]) {
+        MAJOR_TRACE("Disable group \"" << s.groupData(group).name << "\" ("
+                    << s.groupSize(group) << " participants).", true);
+        s.disableGroup(group);
+        active_capacity -= s.groupData(group).capacity;
       }
     } else {
       break;
@@ -472,12 +1543,66 @@ void assignWithMinimumNumberPerGroup(State &s, StudentID min_capacity) {
     State s_temp(s);
     const bool success = assignTeamsAndStudents(s_temp, true);
     if (!success) {
-      ERROR("Could not calculate assignment. Falling back to previous solution.", true);
+      reportFallback("Could not calculate assignment. Falling back to previous solution.");
       break;
     }
     s = s_temp;
   }
   INFO("Initial assignment completed.", true);
+  return true;
+}
+
+// number of students (type specific or not) matching the filter per group
+std::vector<StudentID> numPerGroupForFilter(const State &s, const Filter& filter) {
+  std::vector<StudentID> result(s.numGroups(), 0);
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    for (const auto &pair : s.groupAssignmentList(group)) {
+      if (filter.apply(s.data().students[pair.first])) {
+        result[group]++;
+      }
+    }
+  }
+  return result;
+}
+
+std::vector<std::vector<std::pair<GroupID, StudentID>>>
+typeMinimumViolations(const State &s, const std::vector<std::pair<Filter, StudentID>>& filters) {
+  std::vector<std::vector<std::pair<GroupID, StudentID>>> result(filters.size());
+  for (size_t i = 0; i < filters.size(); ++i) {
+    auto [filter, minimum] = filters[i];
+    std::vector<StudentID> num_per_group = numPerGroupForFilter(s, filter);
+    for (GroupID group = 0; group < s.numGroups(); ++group) {
+      if (num_per_group[group] > 0 && num_per_group[group] < minimum) {
+        result[i].emplace_back(group, num_per_group[group]);
+      }
+    }
+  }
+  return result;
+}
+
+size_t numTypeMinimumViolations(const State &s, const std::vector<std::pair<Filter, StudentID>>& filters) {
+  size_t result = 0;
+  for (const auto& violations: typeMinimumViolations(s, filters)) {
+    result += violations.size();
+  }
+  return result;
+}
+
+void printTypeMinimumViolations(const State &s, const std::vector<std::pair<Filter, StudentID>>& filters) {
+  auto violations = typeMinimumViolations(s, filters);
+  LOG(TRACE_START, 2);
+  LOG(TRACE_START << "# Type Minimum Violations #  group[num/minimum]", 2);
+  for (size_t i = 0; i < filters.size(); ++i) {
+    auto [filter, minimum] = filters[i];
+    std::string line;
+    for (const auto& [group, num]: violations[i]) {
+      if (!line.empty()) {
+        line += ", ";
+      }
+      line += s.groupData(group).name + "[" + std::to_string(num) + "/" + std::to_string(minimum) + "]";
+    }
+    LOG(TRACE_START << std::left << std::setw(17) << filter.name << (line.empty() ? "-" : line), 2);
+  }
 }
 
 StudentID disableTypeSpecificAssignmentBelowThreshold(State &s, uint32_t threshold_index) {
@@ -507,6 +1632,59 @@ StudentID disableTypeSpecificAssignmentBelowThreshold(State &s, uint32_t thresho
   return num_changed;
 }
 
+// index of the filter, group and number of affected students
+using FilterPlacement = std::tuple<size_t, GroupID, StudentID>;
+
+// Selects up to --disabled-groups-per-step groups from which the students of a filter are removed in the next
+// step. For skip_first > 0, the first choice is the (skip_first + 1)-th best option instead of the best one.
+std::vector<FilterPlacement> selectFilterPlacements(const State &s,
+    const std::vector<std::pair<Filter, StudentID>>& filters,
+    std::vector<std::vector<std::pair<GroupID, StudentID>>> group_disable_order, size_t skip_first) {
+  std::vector<FilterPlacement> result;
+  std::vector<bool> group_disabled_in_current_step(s.numGroups(), false);
+  std::vector<StudentID> num_disabled_for_filter(group_disable_order.size(), 0);
+  const StudentID num_steps = Config::get().disabled_groups_per_step;
+  for (StudentID step = 0; step < num_steps; ++step) {
+    std::vector<std::pair<int32_t, size_t>> options;
+    for (size_t j = 0; j < group_disable_order.size(); ++j) {
+      if (!group_disable_order[j].empty()) {
+        bool try_again;
+        do {
+          try_again = false;
+          auto [group, num] = group_disable_order[j].back();
+          StudentID minimum_for_filter = std::get<1>(filters[j]);
+          // 2 times diff to minimum minus current number
+          int32_t rating = 2 * (minimum_for_filter - num) - num;
+          bool is_first_or_small_enough = (num_disabled_for_filter[j] == 0)
+                  || (num_disabled_for_filter[j] + num + 2 <= minimum_for_filter);
+          if (is_first_or_small_enough && !group_disabled_in_current_step[group]) {
+            options.emplace_back(rating, j);
+          } else if (group_disable_order[j].size() > 1 && group_disable_order[j][1].second == num) {
+            // allow next group to be considered
+            group_disable_order[j].pop_back();
+            try_again = true;
+          }
+        } while (try_again);
+      }
+    }
+    const size_t skip = (step == 0) ? skip_first : 0;
+    if (options.size() <= skip) {
+      break;
+    }
+    std::stable_sort(options.begin(), options.end(), [](const auto& o1, const auto& o2) {
+      return o1.first > o2.first;
+    });
+
+    const size_t max_index = options[skip].second;
+    auto [group, num] = group_disable_order[max_index].back();
+    group_disable_order[max_index].pop_back();
+    group_disabled_in_current_step[group] = true;
+    num_disabled_for_filter[max_index] += num;
+    result.emplace_back(max_index, group, num);
+  }
+  return result;
+}
+
 // Top level function that add filters to reassign participants,
 // so that a minimum number per group can be ensured
 void assertMinimumNumberPerGroupForSpecificType(State &s,
@@ -515,6 +1693,16 @@ void assertMinimumNumberPerGroupForSpecificType(State &s,
   bool changed = false;
   bool success = true;
   StudentID num_disabled = 0;
+  // kept if the calculation is stopped (time limit or interrupt)
+  State best(s);
+  size_t best_violations = numTypeMinimumViolations(s, filters);
+  auto update_best = [&] {
+    const size_t violations = numTypeMinimumViolations(s, filters);
+    if (violations < best_violations) {
+      best = s;
+      best_violations = violations;
+    }
+  };
   while (success) {
     if (Config::get().type_specific_assignment_threshold > 0) {
       StudentID disabled = disableTypeSpecificAssignmentBelowThreshold(s, Config::get().type_specific_assignment_threshold);
@@ -546,49 +1734,51 @@ void assertMinimumNumberPerGroupForSpecificType(State &s,
       break;
     }
 
-    // disable groups for specific participants
-    std::vector<bool> group_disabled_in_current_step(s.numGroups(), false);
-    std::vector<StudentID> num_disabled_for_filter(group_disable_order.size(), 0);
-    const StudentID num_steps = Config::get().disabled_groups_per_step;
-    for (StudentID _i = 0; _i < num_steps; ++_i) {
-      size_t max_index = 0;
-      int32_t max_rating = std::numeric_limits<int32_t>::min();
-      for (size_t j = 0; j < group_disable_order.size(); ++j) {
-        if (!group_disable_order[j].empty()) {
-          bool try_again;
-          do {
-            try_again = false;
-            auto [group, num] = group_disable_order[j].back();
-            StudentID minimum_for_filter = std::get<1>(filters[j]);
-            // 2 times diff to minimum minus current number
-            int32_t rating = 2 * (minimum_for_filter - num) - num;
-            bool is_first_or_small_enough = (num_disabled_for_filter[j] == 0)
-                    || (num_disabled_for_filter[j] + num + 2 <= minimum_for_filter);
-            if (is_first_or_small_enough && !group_disabled_in_current_step[group]) {
-              if (rating > max_rating) {
-                max_rating = rating;
-                max_index = j;
-              }
-            } else if (group_disable_order[j].size() > 1 && group_disable_order[j][1].second == num) {
-              // allow next group to be considered
-              group_disable_order[j].pop_back();
-              try_again = true;
-            }
-          } while (try_again);
-        }
-      }
-      if (max_rating == std::numeric_limits<int32_t>::min()) {
+    // choose the groups from which students of specific types are removed
+    std::vector<std::vector<FilterPlacement>> batches;
+    for (size_t variant = 0; variant < Config::get().speculative_filter_batches; ++variant) {
+      std::vector<FilterPlacement> batch = selectFilterPlacements(s, filters, group_disable_order, variant);
+      if (batch.empty()) {
         break;
+      } else if (std::find(batches.begin(), batches.end(), batch) == batches.end()) {
+        batches.push_back(std::move(batch));
       }
-
-      auto [group, num] = group_disable_order[max_index].back();
-      group_disable_order[max_index].pop_back();
-      group_disabled_in_current_step[group] = true;
-      num_disabled_for_filter[max_index] += num;
-      auto [filter, minimum] = filters[max_index];
-      s.addFilterToGroup(group, filter);
-      MAJOR_TRACE("Removing students of type \"" << filter.name << "\" from group \""
-                  << s.groupData(group).name << "\" (" << num << " students)", false);
+    }
+    auto apply_batch = [&](State& state, const std::vector<FilterPlacement>& batch) {
+      for (const auto& [filter_index, group, _]: batch) {
+        state.addFilterToGroup(group, filters[filter_index].first);
+      }
+    };
+    auto log_batch = [&](const std::vector<FilterPlacement>& batch) {
+      for (const auto& [filter_index, group, num]: batch) {
+        MAJOR_TRACE("Removing students of type \"" << filters[filter_index].first.name << "\" from group \""
+                    << s.groupData(group).name << "\" (" << num << " students)", false);
+      }
+    };
+    if (batches.size() > 1) {
+      MAJOR_TRACE("Evaluating " << batches.size() << " alternatives for removing students in parallel.", false);
+      auto result = evaluateVariantsInParallel(s, batches.size(),
+        [&](State& variant, size_t i) {
+          apply_batch(variant, batches[i]);
+        },
+        [&](const State& s1, const State& s2) {
+          const size_t violations_1 = numTypeMinimumViolations(s1, filters);
+          const size_t violations_2 = numTypeMinimumViolations(s2, filters);
+          return violations_1 < violations_2
+                 || (violations_1 == violations_2 && totalWeight(s1) > totalWeight(s2));
+        });
+      success = result.has_value();
+      if (success) {
+        log_batch(batches[result->first]);
+        s = std::move(result->second);
+        update_best();
+      } else {
+        WARNING("Could not continue reassignment. Stopping.", true);
+      }
+      continue;
+    } else if (!batches.empty()) {
+      log_batch(batches[0]);
+      apply_batch(s, batches[0]);
     }
 
     // try to calculate new assignment
@@ -596,6 +1786,7 @@ void assertMinimumNumberPerGroupForSpecificType(State &s,
     success = assignTeamsAndStudents(s_temp, false);
     if (success) {
       s = s_temp;
+      update_best();
     } else {
       WARNING("Could not continue reassignment. Stopping.", true);
     }
@@ -608,12 +1799,108 @@ void assertMinimumNumberPerGroupForSpecificType(State &s,
       s = s_temp;
     }
   }
+  if (cancellationRequested() && best_violations < numTypeMinimumViolations(s, filters)) {
+    WARNING("Calculation stopped. Keeping the assignment with " << best_violations << " remaining violations.", true);
+    s = best;
+  }
   if (success) {
     INFO("Successfully calculated reassignment! (Disabled type specific "
          "assignment for " << num_disabled << " students)", true);
   }
 }
 
+// Top level function that prices the type minima into the edge weights (Lagrangian relaxation).
+// For each filter, the groups with the most students of the type are supposed to reach the minimum
+// and receive a bonus, while the price for all other groups is increased until they contain none
+// of the students. The multipliers are updated with decreasing subgradient steps.
+void assertMinimumNumberPerGroupWithPrices(State &s,
+    const std::vector<std::pair<Filter, StudentID>>& filters) {
+  INFO("Calculating prices to assert minimum numbers per group.", true);
+  const GroupID num_groups = s.numGroups();
+  const int32_t max_price = (Rating(0).getValue(num_groups) - Rating::minRating(num_groups).getValue(num_groups)) / 2;
+  const int32_t base_step = std::max<int32_t>(num_groups, 1);
+  std::vector<std::vector<int32_t>> prices(filters.size(), std::vector<int32_t>(num_groups, 0));
+
+  State best(s);
+  size_t best_violations = numTypeMinimumViolations(s, filters);
+  MAJOR_TRACE("Initial assignment: " << best_violations << " violations.", true);
+  StudentID num_disabled = 0;
+  for (uint32_t iteration = 0; iteration < Config::get().lagrangian_iterations && best_violations > 0; ++iteration) {
+    if (Config::get().type_specific_assignment_threshold > 0) {
+      num_disabled += disableTypeSpecificAssignmentBelowThreshold(s, Config::get().type_specific_assignment_threshold);
+    }
+
+    // subgradient step
+    const int32_t step = std::max<int32_t>(base_step / (iteration + 1), 1);
+    for (size_t i = 0; i < filters.size(); ++i) {
+      auto [filter, minimum] = filters[i];
+      std::vector<StudentID> num_per_group = numPerGroupForFilter(s, filter);
+      std::vector<GroupID> order;
+      StudentID total = 0;
+      for (GroupID group = 0; group < num_groups; ++group) {
+        if (s.groupIsEnabled(group)) {
+          order.push_back(group);
+          total += num_per_group[group];
+        }
+      }
+      std::sort(order.begin(), order.end(), [&](GroupID g1, GroupID g2) {
+        return num_per_group[g1] > num_per_group[g2]
+               || (num_per_group[g1] == num_per_group[g2] && prices[i][g1] < prices[i][g2]);
+      });
+      const size_t num_hosts = (minimum == 0) ? order.size() : total / minimum;
+      for (size_t rank = 0; rank < order.size(); ++rank) {
+        const GroupID group = order[rank];
+        const StudentID num = num_per_group[group];
+        int32_t& price = prices[i][group];
+        if (rank < num_hosts) {
+          price = std::min<int32_t>(price, 0);
+          if (num < minimum) {
+            price = std::max<int32_t>(price - step * static_cast<int32_t>(minimum - num), -max_price);
+          }
+        } else {
+          price = std::max<int32_t>(price, 0);
+          if (num > 0 && num < minimum) {
+            price = std::min<int32_t>(price + step * static_cast<int32_t>(num), max_price);
+          } else if (num >= minimum) {
+            price = 0;
+          }
+        }
+        s.setFilterPrice(group, filter, price);
+      }
+    }
+
+    State s_temp(s);
+    const bool success = assignTeamsAndStudents(s_temp, false);
+    if (!success) {
+      WARNING("Could not continue reassignment. Stopping.", true);
+      break;
+    }
+    s = s_temp;
+    const size_t violations = numTypeMinimumViolations(s, filters);
+    MAJOR_TRACE("Price update " << (iteration + 1) << ": " << violations << " remaining violations.", true);
+    if (violations < best_violations
+        || (violations == best_violations && totalWeight(s) > totalWeight(best))) {
+      best = s;
+      best_violations = violations;
+    }
+  }
+  s = best;
+
+  INFO("Calculated reassignment with prices. (Disabled type specific assignment for "
+       << num_disabled << " students, " << best_violations << " remaining violations)", true);
+  if (Config::get().verbosity_level >= 2) {
+    printTypeMinimumViolations(s, filters);
+  }
+}
+
+void assertTypeMinima(State &s, const std::vector<std::pair<Filter, StudentID>>& filters) {
+  if (Config::get().type_minimum_strategy == TypeMinimumStrategy::Lagrangian) {
+    assertMinimumNumberPerGroupWithPrices(s, filters);
+  } else {
+    assertMinimumNumberPerGroupForSpecificType(s, filters);
+  }
+}
+
 std::vector<std::pair<GroupID, StudentID>>
 groupsByNumFiltered(const State &s, StudentID min_members, const Filter& filter) {
   // we exclude groups that contain a participant which has no viable alternative
@@ -5,18 +5,71 @@
 
 void signalHandler(int);
 
-std::pair<std::vector<int32_t>, bool> calculateAssignment(const State &s, std::mt19937_64& gen, bool top_level);
+bool combinationIsValid(const StudentData &student, const GroupData &group);
+
+bool combinationIsValid(const TeamData &team, const GroupData &group,
+                        const std::vector<StudentData> &students);
+
+bool combinationIsValid(const State &s, ParticipantID part, GroupID group);
+
+// sum of the weights of all groups
+uint64_t totalWeight(const State &s);
+
+// If not all participants can be assigned, the participants contain more students (or participants)
+// than the free capacity of all groups they can be assigned to.
+struct FeasibilityCertificate {
+  bool feasible = true;
+  std::vector<ParticipantID> participants;
+  std::vector<GroupID> groups;
+};
+
+// Checks with a max flow whether all unassigned participants fit into the free capacity of the enabled
+// groups. With team_sizes, a team requires capacity for each member (as for applyAssignment) and might
+// be split, otherwise each participant requires one slot (as for calculateAssignment).
+// The check gates candidate states before a matching is calculated. It does not guarantee that committing
+// the result succeeds, e.g. the teams of a feasible state might still be matched to groups without enough
+// places for all members.
+FeasibilityCertificate checkAssignmentFeasibility(const State &s, bool team_sizes);
+
+// Without check_feasibility, the caller must have checked the state (or an equivalent one) already.
+std::pair<std::vector<int32_t>, bool> calculateAssignment(const State &s, std::mt19937_64& gen, bool top_level,
+                                                          bool check_feasibility = true);
 
 bool applyAssignment(State &s, const std::vector<int32_t> &assignment,
                      bool teams = true, bool students = true, bool top_level = true);
 
 bool assignTeamsAndStudents(State &s, bool top_level);
 
-void assignWithMinimumNumberPerGroup(
+// like assignTeamsAndStudents, but existing assignments are kept
+bool assignRemainingParticipants(State &s, bool top_level);
+
+// Assigns each participant to its previous group (see State::setPreviousAssignment) if the group is still
+// enabled, valid for the participant and has capacity left. Groups without previous participants are
+// disabled if the remaining capacity suffices. Returns the number of kept participants.
+ParticipantID keepPreviousAssignment(State &s);
+
+// expected number of students per group, derived from the ratings and capacities
+std::vector<double> computeGroupDemand(const State &s);
+
+// returns false if no initial assignment exists
+bool assignWithMinimumNumberPerGroup(
     State &s, StudentID min_capacity);
 
 void assertMinimumNumberPerGroupForSpecificType(State &s, const std::vector<std::pair<Filter, StudentID>>& filters);
 
+void assertMinimumNumberPerGroupWithPrices(State &s, const std::vector<std::pair<Filter, StudentID>>& filters);
+
+// uses the strategy selected by --type-minimum-strategy
+void assertTypeMinima(State &s, const std::vector<std::pair<Filter, StudentID>>& filters);
+
+// for each filter, the groups containing students of the type, but less than the minimum
+std::vector<std::vector<std::pair<GroupID, StudentID>>>
+typeMinimumViolations(const State &s, const std::vector<std::pair<Filter, StudentID>>& filters);
+
+size_t numTypeMinimumViolations(const State &s, const std::vector<std::pair<Filter, StudentID>>& filters);
+
+void printTypeMinimumViolations(const State &s, const std::vector<std::pair<Filter, StudentID>>& filters);
+
 // given a specific filter, returns the groups sorted in ascending
 // order by the number of students that would be removed from the
 // group when applying the filter
@@ -1,87 +1,256 @@
 #include "config.h"
 
+static thread_local const Config* active_config = nullptr;
+
+Config::Scope::Scope(const Config* options): _previous(active_config) {
+  active_config = options;
+}
+
+Config::Scope::~Scope() {
+  active_config = _previous;
+}
+
+const Config* Config::activeInstance() {
+  return active_config;
+}
+
 int getTerminalWidth() {
   struct winsize w = { };
   ioctl(0, TIOCGWINSZ, &w);
   return w.ws_col;
 }
 
-po::options_description Config::getConfigOptions() {
+po::options_description Config::getConfigOptions(Config* target) {
+  Config* const config = (target != nullptr) ? target : &get_mut();
   po::options_description options("Further Options", getTerminalWidth());
   options.add_options()
           ("verbosity,v",
-            po::value<uint32_t>(&get_mut().verbosity_level)->value_name("<int>"),
+            po::value<uint32_t>(&config->verbosity_level)->value_name("<int>"),
             "Output verbosity ranging from 0 [no output] to 5 [debug output] (default: 3)")
+          ("log-format",
+            po::value<std::string>()->notifier([config](const std::string& format) {
+              if (format == "text") {
+                config->log_format = LogFormat::Text;
+              } else if (format == "json") {
+                config->log_format = LogFormat::Json;
+              } else {
+                throw po::error("--log-format must be `text` or `json`");
+              }
+            })->value_name("<string>"),
+            "Format of the log output:\n"
+            " - text: colored lines for the terminal (default)\n"
+            " - json: one JSON object per line with time, kind, verbosity and message")
           ("random-seed,s",
-            po::value<uint32_t>(&get_mut().random_seed)->value_name("<int>"),
+            po::value<uint32_t>(&config->random_seed)->value_name("<int>"),
             "Seed for pseudo-randomness used in the algorithm.")
           ("rating-input-type",
-            po::value<std::string>()->notifier([&](const std::string& type) {
+            po::value<std::string>()->notifier([config](const std::string& type) {
               if (type == "mapping") {
-                get_mut().rating_input_type = RatingInputType::Mapping;
+                config->rating_input_type = RatingInputType::Mapping;
               } else if (type == "ordered_list") {
-                get_mut().rating_input_type = RatingInputType::OrderedList;
+                config->rating_input_type = RatingInputType::OrderedList;
               } else {
-                FATAL_ERROR("--rating-input-type must be `mapping` or `ordered_list`");
+                throw po::error("--rating-input-type must be `mapping` or `ordered_list`");
               }
             })->value_name("<string>"),
             "Input format for ratings:\n"
             " - mapping: mapping of group ids to priority (0 is highest)\n"
             " - ordered_list: list of group ids, where the first has the highest priority (and so on)")
           ("output-per-team",
-            po::value<bool>(&get_mut().output_per_team)->value_name("<bool>"),
+            po::value<bool>(&config->output_per_team)->value_name("<bool>"),
             "Outputs the mapping per team instead of per student. Requires that each student is member of a team (default: false).")
           ("input-per-team",
-            po::value<bool>(&get_mut().input_per_team)->value_name("<bool>"),
+            po::value<bool>(&config->input_per_team)->value_name("<bool>"),
             "Input ratings per team instead of per student. Requires that each student is member of a team (default: false).")
+          ("group-report-format",
+            po::value<std::string>()->notifier([config](const std::string& format) {
+              if (format == "files") {
+                config->group_report_format = GroupReportFormat::Files;
+              } else if (format == "csv") {
+                config->group_report_format = GroupReportFormat::Csv;
+              } else {
+                throw po::error("--group-report-format must be `files` or `csv`");
+              }
+            })->value_name("<string>"),
+            "Format of the group reports written with -g:\n"
+            " - files: one file per group (default)\n"
+            " - csv: a single Groups.csv with one line per student")
           ("disabled-groups-per-step,d",
-            po::value<GroupID>(&get_mut().disabled_groups_per_step)->value_name("<int>"),
+            po::value<GroupID>(&config->disabled_groups_per_step)->value_name("<int>"),
             "When reassigning students of specific types, determines how many groups are disabled per step. "
             "A larger value will speed up the algorithm but possibly decrease the quality (default: 3).")
           ("type-specific-assignment-threshold",
-            po::value<uint32_t>(&get_mut().type_specific_assignment_threshold)->value_name("<int>"),
+            po::value<uint32_t>(&config->type_specific_assignment_threshold)->value_name("<int>"),
             "When reassigning students of specific types, do not reassign students if this leads to a rating "
             "below this threshold. Set to 0 to disable (default: 0).")
           ("group-disable-threshold",
-            po::value<StudentID>(&get_mut().group_disable_threshold)->value_name("<int>"),
+            po::value<StudentID>(&config->group_disable_threshold)->value_name("<int>"),
             "Absolute minimum for group size. The algorithm will try to enforce that each group has at least "
             "this number of students, possibly by disabling some of the groups.")
           ("max-team-size",
-            po::value<StudentID>(&get_mut().max_team_size)->value_name("<int>"),
+            po::value<StudentID>(&config->max_team_size)->value_name("<int>"),
             "Maximum allowed team size.")
           ("use-min-group-sizes",
-            po::value<bool>(&get_mut().use_min_group_sizes)->value_name("<bool>"),
+            po::value<bool>(&config->use_min_group_sizes)->value_name("<bool>"),
             "If true, try to distribute students more evenly based on the provided minimum group sizes.")
           ("allow-min-group-size-default",
-            po::value<bool>(&get_mut().allow_min_group_size_default)->value_name("<bool>"),
+            po::value<bool>(&config->allow_min_group_size_default)->value_name("<bool>"),
             "Set reasonable default value for min group size if none is provided.")
           ("min-group-size-effect",
-            po::value<StudentID>(&get_mut().min_group_size_effect)->value_name("<int>"),
+            po::value<StudentID>(&config->min_group_size_effect)->value_name("<int>"),
             "Effect strength of min group size. Between 1 (small effect) and "
             "5 (effectively overrides student preferences).")
           ("allow-default-ratings",
-            po::value<bool>(&get_mut().allow_default_ratings)->value_name("<bool>"),
+            po::value<bool>(&config->allow_default_ratings)->value_name("<bool>"),
             "If true, the rating list of a student might be incomplete and missing entries are replaced "
             "with the worst possible rating.")
           ("capacity-buffer-factor",
-            po::value<double>(&get_mut().capacity_buffer)->value_name("<double>"),
+            po::value<double>(&config->capacity_buffer)->value_name("<double>"),
             "When disabling groups, ensures that the available capacity is at least by this factor "
             "above the number of students (higher capacity generally allows for better solution quality).")
           ("edge-sparsification",
-            po::value<bool>(&get_mut().edge_sparsification)->value_name("<bool>"),
-            "If true, pseudo-randomly sparsifies the edges in the created graph to reduce memory usage.");
+            po::value<bool>(&config->edge_sparsification)->value_name("<bool>"),
+            "If true, pseudo-randomly sparsifies the edges in the created graph to reduce memory usage.")
+          ("matching-engine",
+            po::value<std::string>()->notifier([config](const std::string& engine) {
+              if (engine == "blossom") {
+                config->matching_engine = MatchingEngine::Blossom;
+              } else if (engine == "lapjv") {
+                config->matching_engine = MatchingEngine::Lapjv;
+              } else if (engine == "flow") {
+                config->matching_engine = MatchingEngine::Flow;
+              } else if (engine == "auto") {
+                config->matching_engine = MatchingEngine::Auto;
+              } else {
+                throw po::error("--matching-engine must be `blossom`, `lapjv`, `flow` or `auto`");
+              }
+            })->value_name("<string>"),
+            "Algorithm for the weighted matching of participants to group slots:\n"
+            " - blossom: general maximum weighted matching on the (sparsified) graph (default)\n"
+            " - lapjv: shortest augmenting paths on a dense participants x slots matrix, "
+            "fast for small and medium instances but without edge sparsification\n"
+            " - flow: min cost flow on classes of participants with identical weights, "
+            "fast if many participants share their ratings and types\n"
+            " - auto: lapjv if the matrix has at most 4M entries, otherwise blossom")
+          ("group-disable-strategy",
+            po::value<std::string>()->notifier([config](const std::string& strategy) {
+              if (strategy == "incremental") {
+                config->group_disable_strategy = GroupDisableStrategy::Incremental;
+              } else if (strategy == "bulk") {
+                config->group_disable_strategy = GroupDisableStrategy::Bulk;
+              } else {
+                throw po::error("--group-disable-strategy must be `incremental` or `bulk`");
+              }
+            })->value_name("<string>"),
+            "Strategy for disabling groups below --group-disable-threshold:\n"
+            " - incremental: raise the allowed minimum by one per step and recalculate (default)\n"
+            " - bulk: disable all groups predicted to stay too small (based on the demand from the ratings) "
+            "at once and verify with a single calculation")
+          ("demand-predisable-factor",
+            po::value<double>(&config->demand_predisable_factor)->value_name("<double>"),
+            "Before the first calculation, disables groups with an expected demand (derived from the ratings) "
+            "below this factor times --group-disable-threshold. Set to 0 to disable (default: 0).")
+          ("speculative-candidates",
+            po::value<uint32_t>(&config->speculative_candidates)->value_name("<int>"),
+            "When disabling groups below --group-disable-threshold, evaluates up to this number of "
+            "alternative choices for the disabled groups in parallel and keeps the best. "
+            "Set to 1 to disable (default: 1).")
+          ("speculative-filter-batches",
+            po::value<uint32_t>(&config->speculative_filter_batches)->value_name("<int>"),
+            "When reassigning students of specific types, evaluates up to this number of alternative choices "
+            "for the groups of each step in parallel and keeps the one with the fewest remaining violations. "
+            "Set to 1 to disable (default: 1).")
+          ("type-minimum-strategy",
+            po::value<std::string>()->notifier([config](const std::string& strategy) {
+              if (strategy == "filters") {
+                config->type_minimum_strategy = TypeMinimumStrategy::Filters;
+              } else if (strategy == "lagrangian") {
+                config->type_minimum_strategy = TypeMinimumStrategy::Lagrangian;
+              } else {
+                throw po::error("--type-minimum-strategy must be `filters` or `lagrangian`");
+              }
+            })->value_name("<string>"),
+            "Strategy for asserting the minimum numbers per student type:\n"
+            " - filters: iteratively remove students of a type from groups and recalculate (default)\n"
+            " - lagrangian: add prices for student types to the edge weights, updated by subgradient steps")
+          ("lagrangian-iterations",
+            po::value<uint32_t>(&config->lagrangian_iterations)->value_name("<int>"),
+            "Maximum number of price updates for --type-minimum-strategy=lagrangian (default: 8).")
+          ("exact-solve",
+            po::value<bool>(&config->exact_solve)->value_name("<bool>"),
+            "If true, calculates an upper bound and the optimality gap of the result via branch and bound "
+            "and uses the exact solution if it is better. Only feasible for small instances (default: false).")
+          ("exact-node-limit",
+            po::value<uint32_t>(&config->exact_node_limit)->value_name("<int>"),
+            "Maximum number of branch and bound nodes for --exact-solve (default: 1000).")
+          ("threads",
+            po::value<uint32_t>(&config->threads)->value_name("<int>"),
+            "Number of worker threads used for parallel computations. "
+            "Set to 0 to use the number of available cores (default: 0).")
+          ("move-penalty",
+            po::value<uint32_t>(&config->move_penalty)->value_name("<int>"),
+            "With --previous-output: If 0, previous assignments are kept fixed and only the remaining participants "
+            "are assigned. Otherwise, everything is recalculated, but assigning a participant to another group "
+            "than before reduces the weight by this value (default: 0).")
+          ("memory-limit",
+            po::value<uint32_t>(&config->memory_limit)->value_name("<int>"),
+            "Approximate memory limit in MiB for the matchings: The size of the graph is estimated before it is "
+            "built and the edge sparsification is increased or the matching engine is changed (dense assignment "
+            "or flow on participant classes) to stay below the limit. Concurrent matchings (one per thread) and "
+            "the configurations of a sweep share the limit (default: 0, no limit).")
+          ("time-limit",
+            po::value<double>(&config->time_limit)->value_name("<float>"),
+            "Time limit in seconds: When it is reached (or on SIGINT), the calculation stops and the best "
+            "assignment found so far is written. If the initial assignment is not finished yet, it is calculated via "
+            "flow within half of the limit (at least 1 s). Applies to each solve request in server mode and to each "
+            "configuration of a sweep (default: 0, no limit).");
   // TODO: remaining options
   return options;
 }
 
+std::optional<Config> Config::withOverrides(const std::vector<std::pair<std::string, std::string>>& overrides,
+                                           std::string& error) {
+  Config result = get();
+  std::vector<std::string> args;
+  for (const auto& [name, value] : overrides) {
+    args.push_back("--" + name + "=" + value);
+  }
+  po::variables_map vm;
+  try {
+    po::store(po::command_line_parser(args).options(getConfigOptions(&result)).run(), vm);
+    po::notify(vm);
+  } catch (const po::error& e) {
+    error = std::string("Invalid option override: ") + e.what();
+    return std::nullopt;
+  }
+  return result;
+}
+
 void Config::check() {
-    ASSERT_WITH(get().verbosity_level <= 5,
-                "--verbosity must be between 0 and 5");
-    ASSERT_WITH(get().capacity_buffer > 1,
-                "--capacity-buffer-factor must be > 1");
-    ASSERT_WITH(get().min_group_size_effect > 0 && get().min_group_size_effect <= 5,
-                "--min-group-size-effect must be between 1 and 5");
-    if (!get().use_min_group_sizes) {
-      get_mut().allow_min_group_size_default = true;
+    const std::string message = validate();
+    if (!message.empty()) {
+      FATAL_ERROR(message);
+    }
+    if (get().verbosity_level > LOG_MAX_VERBOSITY) {
+      WARNING("Messages above verbosity " << LOG_MAX_VERBOSITY << " are disabled in this build.", true);
+    }
+}
+
+std::string Config::validate() {
+    if (get().verbosity_level > 5) {
+      return "--verbosity must be between 0 and 5";
+    } else if (!(get().capacity_buffer > 1)) {
+      return "--capacity-buffer-factor must be > 1";
+    } else if (!(get().time_limit >= 0)) {
+      return "--time-limit must be >= 0";
+    } else if (!(get().demand_predisable_factor >= 0)) {
+      return "--demand-predisable-factor must be >= 0";
+    } else if (get().speculative_candidates == 0) {
+      return "--speculative-candidates must be > 0";
+    } else if (get().speculative_filter_batches == 0) {
+      return "--speculative-filter-batches must be > 0";
+    } else if (get().min_group_size_effect == 0 || get().min_group_size_effect > 5) {
+      return "--min-group-size-effect must be between 1 and 5";
     }
+    return "";
 }
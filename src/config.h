@@ -2,6 +2,8 @@
 
 #include <stdint.h>
 #include <iostream>
+#include <optional>
+#include <string>
 #include <sys/ioctl.h>
 
 #include "boost/program_options.hpp"
@@ -12,21 +14,50 @@ namespace po = boost::program_options;
 
 int getTerminalWidth();
 
+enum class LogFormat {
+  Text,
+  Json
+};
+
 enum class RatingInputType {
   Mapping,
   OrderedList
 };
 
-// holds all config options in a singleton
+enum class GroupDisableStrategy {
+  Incremental,
+  Bulk
+};
+
+enum class GroupReportFormat {
+  Files,
+  Csv
+};
+
+enum class MatchingEngine {
+  Blossom,
+  Lapjv,
+  Flow,
+  Auto
+};
+
+enum class TypeMinimumStrategy {
+  Filters,
+  Lagrangian
+};
+
+// holds all config options in a singleton, which can be overridden per thread with a Scope
 class Config {
  public:
   uint32_t verbosity_level = 3;
+  LogFormat log_format = LogFormat::Text;
   uint32_t random_seed = 7;
 
   // input and output
   RatingInputType rating_input_type = RatingInputType::Mapping;
   bool output_per_team = false;
   bool input_per_team = false;
+  GroupReportFormat group_report_format = GroupReportFormat::Files;
 
   // algorithm
   GroupID disabled_groups_per_step = 3;
@@ -39,15 +70,65 @@ class Config {
   uint32_t min_group_size_effect = 3;
   double capacity_buffer = 1.05;
   bool edge_sparsification = true;
+  MatchingEngine matching_engine = MatchingEngine::Blossom;
+  GroupDisableStrategy group_disable_strategy = GroupDisableStrategy::Incremental;
+  double demand_predisable_factor = 0;
+  uint32_t speculative_candidates = 1;
+  uint32_t speculative_filter_batches = 1;
+  TypeMinimumStrategy type_minimum_strategy = TypeMinimumStrategy::Filters;
+  uint32_t lagrangian_iterations = 8;
+  bool exact_solve = false;
+  uint32_t exact_node_limit = 1000;
+  uint32_t threads = 0;
+  uint32_t move_penalty = 0;
+  // in MiB, 0 for no limit
+  uint32_t memory_limit = 0;
+  // in seconds, 0 for no limit
+  double time_limit = 0;
 
+  // default minimum group sizes are always allowed if the minimum group sizes are not used
+  bool allowMinGroupSizeDefault() const {
+    return allow_min_group_size_default || !use_min_group_sizes;
+  }
+
+  // the options activated for the current thread, otherwise the global options
   static const Config& get() {
-    return get_mut();
+    const Config* active = activeInstance();
+    return (active != nullptr) ? *active : get_mut();
   }
 
-  static po::options_description getConfigOptions();
+  // Activates the options for the current thread while alive, e.g. for a library call.
+  // Tasks submitted to the thread pool inherit the options of the submitting thread.
+  class Scope {
+   public:
+    explicit Scope(const Config* options);
+
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    const Config* _previous;
+  };
 
+  // nullptr if no options are activated for the current thread
+  static const Config* activeInstance();
+
+  // the values are parsed into `target`, by default into the global options
+  static po::options_description getConfigOptions(Config* target = nullptr);
+
+  // Copy of the active options with the given options (name and value as in the config file) overridden.
+  // The global options are not modified. Returns std::nullopt and sets `error` for unknown options or values.
+  static std::optional<Config> withOverrides(const std::vector<std::pair<std::string, std::string>>& overrides,
+                                             std::string& error);
+
+  // validates the active options without modifying them, i.e. it is safe for concurrent library calls
   static void check();
 
+  // returns the reason why check() would reject the active options (empty if they are valid)
+  static std::string validate();
+
  private:
   // use only for initialization
   static Config& get_mut() {
@@ -2,10 +2,143 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <limits>
+#include <mutex>
+#include <thread>
 
 #include "config.h"
 #include "io.h"
 
+// ####################################
+// ########      Logging       ########
+// ####################################
+
+static thread_local const LogSink* active_log_sink = nullptr;
+
+LogScope::LogScope(const LogSink* sink): _previous(active_log_sink) {
+  active_log_sink = sink;
+}
+
+LogScope::~LogScope() {
+  active_log_sink = _previous;
+}
+
+const LogSink* LogScope::active() {
+  return active_log_sink;
+}
+
+// Collects the lines for stdout and writes them in batches from a background thread, which is started
+// with the first line. Producers only block if the writer falls far behind.
+class AsyncLogWriter {
+  static constexpr size_t MAX_PENDING_LINES = 1 << 16;
+
+  std::mutex _mutex;
+  std::condition_variable _pending_cv;
+  std::condition_variable _written_cv;
+  std::vector<std::string> _pending;
+  uint64_t _num_enqueued = 0;
+  uint64_t _num_written = 0;
+  bool _started = false;
+
+ public:
+  // leaked intentionally, so pool workers can still log during static destruction
+  static AsyncLogWriter& get() {
+    static AsyncLogWriter* writer = new AsyncLogWriter();
+    return *writer;
+  }
+
+  void push(std::string line) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!_started) {
+      _started = true;
+      std::thread([this] { run(); }).detach();
+      std::atexit(flushLog);
+    }
+    _written_cv.wait(lock, [&] { return _pending.size() < MAX_PENDING_LINES; });
+    _pending.push_back(std::move(line));
+    ++_num_enqueued;
+    _pending_cv.notify_one();
+  }
+
+  void flush() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    const uint64_t target = _num_enqueued;
+    _written_cv.wait(lock, [&] { return _num_written >= target; });
+  }
+
+ private:
+  void run() {
+    std::vector<std::string> batch;
+    std::string buffer;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _num_written += batch.size();
+        _written_cv.notify_all();
+        batch.clear();
+        _pending_cv.wait(lock, [&] { return !_pending.empty(); });
+        std::swap(batch, _pending);
+      }
+      buffer.clear();
+      for (const std::string& line : batch) {
+        buffer += line;
+        buffer += '\n';
+      }
+      std::cout.write(buffer.data(), buffer.size());
+      std::cout.flush();
+    }
+  }
+};
+
+static const auto log_start_time = std::chrono::steady_clock::now();
+
+// escapes the message as JSON string and drops the color codes
+void appendJsonString(std::string& out, const std::string& message) {
+  out += '"';
+  for (size_t i = 0; i < message.size(); ++i) {
+    const char c = message[i];
+    if (c == '\033') {
+      while (i < message.size() && message[i] != 'm') {
+        ++i;
+      }
+    } else if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (c == '\n') {
+      out += "\\n";
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out += escaped;
+    } else {
+      out += c;
+    }
+  }
+  out += '"';
+}
+
+void writeLogLine(const char* kind, uint32_t verbosity, const char* prefix, const std::string& message) {
+  if (active_log_sink != nullptr && *active_log_sink) {
+    (*active_log_sink)(prefix + message);
+  } else if (Config::get().log_format == LogFormat::Json) {
+    const double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - log_start_time).count();
+    std::string line = "{\"time\": " + std::to_string(time) + ", \"kind\": \"" + kind
+                       + "\", \"verbosity\": " + std::to_string(verbosity) + ", \"message\": ";
+    appendJsonString(line, message);
+    line += '}';
+    AsyncLogWriter::get().push(std::move(line));
+  } else {
+    AsyncLogWriter::get().push(prefix + message);
+  }
+}
+
+void flushLog() {
+  AsyncLogWriter::get().flush();
+}
+
 // ####################################
 // ########     Input Data     ########
 // ####################################
@@ -36,13 +169,104 @@ Rating Rating::minRating(GroupID num_groups) {
   return Rating(num_groups - 1);
 }
 
+RatingList::RatingList(std::vector<Rating> ratings): _num_groups(ratings.size()), _dense(std::move(ratings)) {}
+
+RatingList::RatingList(GroupID num_groups, std::vector<std::pair<GroupID, Rating>> rated, Rating default_rating):
+    _num_groups(num_groups), _default(default_rating) {
+  // the sparse representation only pays off if most groups have the default rating
+  if (2 * rated.size() >= num_groups) {
+    _dense.assign(num_groups, default_rating);
+    for (const auto& [group, rating] : rated) {
+      ASSERT(group < num_groups);
+      _dense[group] = rating;
+    }
+    return;
+  }
+  // for duplicates, the last rating wins
+  std::stable_sort(rated.begin(), rated.end(), [](const auto& lhs, const auto& rhs) {
+    return lhs.first < rhs.first;
+  });
+  for (const auto& entry : rated) {
+    ASSERT(entry.first < num_groups);
+    if (!_sparse.empty() && _sparse.back().first == entry.first) {
+      _sparse.back().second = entry.second;
+    } else {
+      _sparse.push_back(entry);
+    }
+  }
+}
+
+Rating RatingList::at(GroupID group) const {
+  if (!isSparse()) {
+    return _dense[group];
+  }
+  auto it = std::lower_bound(_sparse.begin(), _sparse.end(), group, [](const auto& entry, GroupID g) {
+    return entry.first < g;
+  });
+  return (it != _sparse.end() && it->first == group) ? it->second : _default;
+}
+
+Rating RatingList::operator[](GroupID group) const {
+  return at(group);
+}
+
+GroupID RatingList::size() const {
+  return _num_groups;
+}
+
+bool RatingList::empty() const {
+  return _num_groups == 0;
+}
+
+bool RatingList::isSparse() const {
+  return _dense.size() != _num_groups;
+}
+
+void RatingList::setDefault(Rating rating) {
+  for (Rating& r : _dense) {
+    if (!r.isValid()) {
+      r = rating;
+    }
+  }
+  for (auto& entry : _sparse) {
+    if (!entry.second.isValid()) {
+      entry.second = rating;
+    }
+  }
+  if (!_default.isValid()) {
+    _default = rating;
+  }
+}
+
+bool RatingList::isComplete() const {
+  auto valid = [](const Rating& r) { return r.isValid(); };
+  if (!isSparse()) {
+    return std::all_of(_dense.begin(), _dense.end(), valid);
+  }
+  return (_sparse.size() == _num_groups || _default.isValid())
+         && std::all_of(_sparse.begin(), _sparse.end(), [](const auto& entry) { return entry.second.isValid(); });
+}
+
+bool RatingList::operator==(const RatingList &other) const {
+  if (_num_groups != other._num_groups) {
+    return false;
+  }
+  for (GroupID group = 0; group < _num_groups; ++group) {
+    if (at(group) != other.at(group)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 GroupData::GroupData(std::string id, std::string name, StudentID capacity,
                      StudentID min_target_size, CourseType ct, DegreeType dt)
     : id(id), name(name), capacity(capacity),
       min_target_size(min_target_size), course_type(ct), degree_type(dt) {}
 
 StudentData::StudentData(std::string id, std::string name, CourseType ct, DegreeType dt, Semester s, bool ts)
-    : id(id), name(name), course_type(ct), degree_type(dt), semester(s), type_specific_assignment(ts) {}
+    : id(id), name(name), course_type(ct), degree_type(dt), semester(s),
+      type_specific_assignment(ts) {}
 
 TeamData::TeamData(std::string id, std::vector<StudentID> members)
     : id(id), members(std::move(members)) {
@@ -52,6 +276,10 @@ TeamData::TeamData(std::string id, std::vector<StudentID> members)
 
 size_t TeamData::size() const { return members.size(); }
 
+int32_t Input::teamOfStudent(StudentID student) const {
+  return (student < team_of_student.size()) ? team_of_student[student] : -1;
+}
+
 // #########################################
 // ########     Assignment Data     ########
 // #########################################
@@ -82,20 +310,6 @@ uint32_t Filter::id() const {
   return result;
 }
 
-bool ratingsEqual(const std::vector<Rating> &r1,
-                  const std::vector<Rating> &r2) {
-  if (r1.size() != r2.size()) {
-    return false;
-  }
-
-  for (size_t i = 0; i < r1.size(); ++i) {
-    if (r1[i] != r2[i]) {
-      return false;
-    }
-  }
-  return true;
-}
-
 Participant::Participant(uint32_t index, bool is_team)
     : index(index), is_team(is_team), assignment(-1) {}
 
@@ -106,22 +320,20 @@ State::State(Input &data, std::mt19937_64& random_gen)
                          std::vector<std::pair<StudentID, ParticipantID>>()),
       _participants(),
       _type_specific_assignment(data.students.size()),
-      _random_gen(random_gen) {
+      _random_gen(random_gen),
+      _filter_registry(std::make_shared<FilterRegistry>()) {
   ASSERT(data.students.size() == data.ratings.size());
   std::vector<bool> is_in_team(data.students.size(), false);
 
   // sanitize ratings, check mapping to team id, copy data
   for (StudentID student = 0; student < data.ratings.size(); ++student) {
     _type_specific_assignment[student] = data.students[student].type_specific_assignment;
-    for (Rating& rating: data.ratings[student]) {
-      if (Config::get().allow_default_ratings && !rating.isValid()) {
-        rating = Rating::minRating(data.groups.size());
-      }
-      ASSERT_WITH(rating.isValid(), "Invalid rating for student \"" << data.students[student].id << "\"");
+    if (Config::get().allow_default_ratings) {
+      data.ratings[student].setDefault(Rating::minRating(data.groups.size()));
     }
-    const std::string& student_id = data.students[student].id;
-    if ((Config::get().output_per_team || Config::get().input_per_team)
-        && data.student_id_to_team_id.find(student_id) == data.student_id_to_team_id.end()) {
+    ASSERT_WITH(data.ratings[student].isComplete(), "Invalid rating for student \"" << data.students[student].id << "\"");
+    const std::string_view student_id = data.students[student].id;
+    if ((Config::get().output_per_team || Config::get().input_per_team) && data.teamOfStudent(student) < 0) {
       FATAL_ERROR("Input/output per team requested. But student \"" << student_id << "\" is not member of a team.\n"
                   << "You either need to sanitize the input data or use --input-per-team=false/--output-per-team=false");
     }
@@ -132,7 +344,7 @@ State::State(Input &data, std::mt19937_64& random_gen)
     const TeamData &team = data.teams[team_id];
     ASSERT_WITH(team.members.size() > 0, "team \"" << team.id << "\" has no member");
     if (team.members.size() > 1) {
-      std::vector<Rating> team_rating;
+      RatingList team_rating;
       const StudentData* first_student_type_specific = nullptr;
       for (const StudentID &student : team.members) {
         ASSERT(student < is_in_team.size() && !is_in_team[student]);
@@ -140,7 +352,7 @@ State::State(Input &data, std::mt19937_64& random_gen)
                     "student \"" << data.students[student].id << "\" has invalid rating");
         is_in_team[student] = true;
         if (!data.ratings[student].empty()) {
-          ASSERT_WITH(team_rating.empty() || ratingsEqual(data.ratings[student], team_rating),
+          ASSERT_WITH(team_rating.empty() || data.ratings[student] == team_rating,
                       "conflicting ratings for team \"" << team.id << "\"");
           team_rating = data.ratings[student];
         }
@@ -199,6 +411,74 @@ State::State(Input &data, std::mt19937_64& random_gen)
   ASSERT_WITH(data.students.size() == total_count,
               "Internal error: Student count (" << data.students.size()
               << ") does not match mapped count (" << total_count << ").");
+  for (GroupID group = 0; group < data.groups.size(); ++group) {
+    ASSERT_WITH(computeSlotBonus(groupCapacity(group), groupMinSize(group), _group_states[group].slot_bonus),
+                "Min size of group \"" << data.groups[group].id << "\" must be significantly below its capacity.");
+  }
+}
+
+std::string State::checkInput(const Input &data) {
+  if (data.students.size() != data.ratings.size()) {
+    return "Number of ratings does not match the number of students";
+  }
+  // ratings as completed by the constructor
+  auto effective_rating = [&](StudentID student) {
+    RatingList rating = data.ratings[student];
+    if (Config::get().allow_default_ratings) {
+      rating.setDefault(Rating::minRating(data.groups.size()));
+    }
+    return rating;
+  };
+  std::vector<bool> is_in_team(data.students.size(), false);
+  for (const TeamData& team : data.teams) {
+    if (team.members.empty()) {
+      return "Team \"" + std::string(team.id) + "\" has no member";
+    } else if (team.members.size() == 1) {
+      continue;
+    }
+    RatingList team_rating;
+    for (StudentID student : team.members) {
+      if (student >= data.students.size() || is_in_team[student]) {
+        return "Invalid member of team \"" + std::string(team.id) + "\"";
+      }
+      is_in_team[student] = true;
+      const RatingList rating = effective_rating(student);
+      if (rating.empty()) {
+        continue;
+      } else if (rating.size() != data.groups.size()) {
+        return "Student \"" + std::string(data.students[student].id) + "\" has invalid rating";
+      } else if (!team_rating.empty() && !(rating == team_rating)) {
+        return "Conflicting ratings for team \"" + std::string(team.id) + "\"";
+      }
+      team_rating = rating;
+    }
+    if (team_rating.empty()) {
+      return "No rating found for team \"" + std::string(team.id) + "\"";
+    }
+  }
+  for (StudentID student = 0; student < data.students.size(); ++student) {
+    const RatingList rating = effective_rating(student);
+    if (!rating.isComplete() || (!is_in_team[student] && rating.size() != data.groups.size())) {
+      return "Invalid rating for student \"" + std::string(data.students[student].id) + "\"";
+    }
+    if ((Config::get().output_per_team || Config::get().input_per_team) && data.teamOfStudent(student) < 0) {
+      return "Student \"" + std::string(data.students[student].id) + "\" is not member of a team";
+    }
+  }
+  StudentID total_capacity = 0;
+  for (const GroupData& group : data.groups) {
+    total_capacity += group.capacity;
+  }
+  if (total_capacity < ceil(Config::get().capacity_buffer * data.students.size())) {
+    return "Not enough capacity available";
+  }
+  std::vector<int32_t> slot_bonus;
+  for (const GroupData& group : data.groups) {
+    if (!computeSlotBonus(group.capacity, group.min_target_size, slot_bonus)) {
+      return "Min size of group \"" + std::string(group.id) + "\" must be significantly below its capacity";
+    }
+  }
+  return "";
 }
 
 const Input &State::data() const { return _data.get(); }
@@ -235,6 +515,54 @@ StudentID State::groupCapacity(GroupID id) const {
   return groupData(id).capacity - _group_states[id].reduced_capacity;
 }
 
+// x^e * y^f, saturated at the maximum value
+static uint64_t saturatedPowerProduct(uint64_t x, uint32_t e, uint64_t y, uint32_t f) {
+  uint64_t result = 1;
+  for (uint32_t i = 0; i < e + f; ++i) {
+    if (__builtin_mul_overflow(result, i < e ? x : y, &result)) {
+      return std::numeric_limits<uint64_t>::max();
+    }
+  }
+  return result;
+}
+
+bool State::computeSlotBonus(StudentID capacity, StudentID min_size, std::vector<int32_t>& bonus) {
+  const Config& config = Config::get();
+  const uint32_t effect = config.min_group_size_effect;
+  bonus.assign(capacity, effect);
+  if (!config.use_min_group_sizes || capacity == 0) {
+    return true;
+  } else if (min_size == 0) {
+    // only the first slot is better than the others
+    std::fill(bonus.begin() + 1, bonus.end(), effect - 1);
+    return true;
+  }
+  // the t-th step happens at the first slot j with j + 2 > min_size * (capacity / min_size)^(t / effect)
+  bool valid = true;
+  uint32_t steps = 0;
+  for (StudentID j = 0; j < capacity; ++j) {
+    bonus[j] = std::max<int32_t>(effect - steps, 0);
+    if (steps <= effect && saturatedPowerProduct(j + 2, effect, 1, 0) >
+                           saturatedPowerProduct(min_size, effect - steps, capacity, steps)) {
+      valid = valid && (j == 0 || j + 1 < capacity || steps == effect);
+      ++steps;
+    }
+  }
+  return valid;
+}
+
+const std::vector<int32_t>& State::slotBonus(GroupID id) const {
+  ASSERT(id < data().groups.size() && _group_states[id].enabled);
+  return _group_states[id].slot_bonus;
+}
+
+void State::updateSlotBonus(GroupID id) {
+  GroupState& state = _group_states[id];
+  if (state.enabled) {
+    computeSlotBonus(groupCapacity(id), groupMinSize(id), state.slot_bonus);
+  }
+}
+
 StudentID State::groupMinSize(GroupID id) const {
   ASSERT(id < data().groups.size());
   if (_group_states[id].reduced_capacity >= groupData(id).min_target_size) {
@@ -303,7 +631,7 @@ GroupID State::assignment(ParticipantID id) const {
   return static_cast<GroupID>(_participants[id].assignment);
 }
 
-const std::vector<Rating> &State::rating(ParticipantID id) const {
+const RatingList &State::rating(ParticipantID id) const {
   StudentID student_id;
   if (isTeam(id)) {
     student_id = teamData(id).members[0];
@@ -316,23 +644,45 @@ const std::vector<Rating> &State::rating(ParticipantID id) const {
 void State::disableGroup(GroupID id) {
   ASSERT(id < data().groups.size());
   _group_states[id].enabled = false;
+  _group_states[id].slot_bonus.clear();
 }
 
 void State::addFilterToGroup(GroupID id, Filter filter) {
   ASSERT(id < data().groups.size());
-  if (!groupContainsFilter(id, filter)) {
-    _group_states[id].participant_filters.push_back(filter);
-  }
+  _group_states[id].participant_filters |= uint64_t(1) << internFilter(filter);
 }
 
 bool State::groupContainsFilter(GroupID id, const Filter& filter) const {
   ASSERT(id < data().groups.size());
-  for (const Filter& f: _group_states[id].participant_filters) {
-    if (filter.id() == f.id()) {
-      return true;
+  const int32_t handle = filterHandle(filter);
+  return handle >= 0 && ((_group_states[id].participant_filters >> handle) & 1) != 0;
+}
+
+int32_t State::filterHandle(const Filter& filter) const {
+  const auto& handle_of_id = _filter_registry->handle_of_id;
+  auto it = handle_of_id.find(filter.id());
+  return (it != handle_of_id.end()) ? static_cast<int32_t>(it->second) : -1;
+}
+
+uint32_t State::internFilter(const Filter& filter) {
+  const int32_t existing = filterHandle(filter);
+  if (existing >= 0) {
+    return existing;
+  }
+  // copy on write, since the registry might be used by copies of the state in other threads
+  auto registry = std::make_shared<FilterRegistry>(*_filter_registry);
+  const uint32_t handle = registry->filters.size();
+  ASSERT_WITH(handle < FilterRegistry::MAX_FILTERS, "Too many different filters");
+  registry->filters.push_back(filter);
+  registry->handle_of_id.emplace(filter.id(), handle);
+  registry->student_masks.resize(data().students.size(), 0);
+  for (StudentID student = 0; student < data().students.size(); ++student) {
+    if (filter.apply(data().students[student])) {
+      registry->student_masks[student] |= uint64_t(1) << handle;
     }
   }
-  return false;
+  _filter_registry = std::move(registry);
+  return handle;
 }
 
 bool State::filterAppliesToParticipant(ParticipantID participant, const Filter& filter) const {
@@ -352,16 +702,9 @@ bool State::filterAppliesToParticipant(ParticipantID participant, const Filter&
 
 bool State::studentIsExludedFromGroup(StudentID student, GroupID group) const {
   ASSERT(group < data().groups.size());
-  const StudentData& s_data = data().students[student];
-  if (!_type_specific_assignment[student]) {
-    return false;
-  }
-  for (auto filter : _group_states[group].participant_filters) {
-    if (filter.apply(s_data)) {
-      return true;
-    }
-  }
-  return false;
+  const uint64_t group_filters = _group_states[group].participant_filters;
+  return group_filters != 0 && _type_specific_assignment[student]
+         && (_filter_registry->student_masks[student] & group_filters) != 0;
 }
 
 bool State::isExludedFromGroup(ParticipantID participant, GroupID group) const {
@@ -380,6 +723,85 @@ bool State::isExludedFromGroup(ParticipantID participant, GroupID group) const {
   }
 }
 
+void State::setFilterPrice(GroupID id, const Filter& filter, int32_t price) {
+  ASSERT(id < data().groups.size());
+  const uint32_t handle = internFilter(filter);
+  auto& prices = _group_states[id].participant_prices;
+  for (auto& [h, p]: prices) {
+    if (h == handle) {
+      p = price;
+      return;
+    }
+  }
+  if (price != 0) {
+    prices.emplace_back(handle, price);
+  }
+}
+
+int32_t State::studentPrice(StudentID student, GroupID group) const {
+  ASSERT(group < data().groups.size());
+  if (!_type_specific_assignment[student]) {
+    return 0;
+  }
+  const uint64_t student_mask = _filter_registry->student_masks[student];
+  int32_t result = 0;
+  for (const auto& [handle, price] : _group_states[group].participant_prices) {
+    if (((student_mask >> handle) & 1) != 0) {
+      result += price;
+    }
+  }
+  return result;
+}
+
+int32_t State::participantPrice(ParticipantID participant, GroupID group) const {
+  ASSERT(participant < _participants.size());
+  ASSERT(group < data().groups.size());
+  if (_group_states[group].participant_prices.empty()) {
+    return 0;
+  }
+
+  if (isTeam(participant)) {
+    int32_t result = 0;
+    for (StudentID student : teamData(participant).members) {
+      result += studentPrice(student, group);
+    }
+    return result;
+  } else {
+    return studentPrice(_participants[participant].index, group);
+  }
+}
+
+void State::setPreviousAssignment(const std::vector<int32_t>& previous_group, uint32_t move_penalty) {
+  ASSERT(previous_group.size() == data().students.size());
+  _previous_group.assign(_participants.size(), -1);
+  _move_penalty = move_penalty;
+  for (ParticipantID part = 0; part < _participants.size(); ++part) {
+    if (isTeam(part)) {
+      for (StudentID member : teamData(part).members) {
+        if (previous_group[member] >= 0) {
+          _previous_group[part] = previous_group[member];
+          break;
+        }
+      }
+    } else {
+      _previous_group[part] = previous_group[_participants[part].index];
+    }
+  }
+}
+
+int32_t State::previousGroup(ParticipantID participant) const {
+  ASSERT(participant < _participants.size());
+  return _previous_group.empty() ? -1 : _previous_group[participant];
+}
+
+uint32_t State::movePenalty(ParticipantID participant, GroupID group) const {
+  const int32_t previous = previousGroup(participant);
+  if (previous < 0 || static_cast<GroupID>(previous) == group) {
+    return 0;
+  }
+  return _move_penalty;
+}
+
 bool State::assignParticipant(ParticipantID participant, GroupID target) {
   ASSERT(!isAssigned(participant));
   ASSERT(target < data().groups.size());
@@ -405,6 +827,7 @@ bool State::assignParticipant(ParticipantID participant, GroupID target) {
     _group_states[target].weight += rating(participant)[target].getValue(numGroups());
   }
   _participants[participant].assignment = target;
+  updateSlotBonus(target);
   return true;
 }
 
@@ -429,6 +852,7 @@ void State::unassignParticipant(ParticipantID participant, GroupID group) {
     }
   }
   _participants[participant].assignment = -1;
+  updateSlotBonus(group);
 }
 
 // groups are still disabled and keep their filters
@@ -437,6 +861,7 @@ void State::reset() {
     GroupState& state = _group_states[group];
     state.reduced_capacity = 0;
     state.weight = 0;
+    updateSlotBonus(group);
   }
   for (auto &assigned : _group_assignments) {
     assigned.clear();
@@ -449,6 +874,7 @@ void State::reset() {
 void State::setCapacity(GroupID id, uint32_t val) {
   ASSERT(id < data().groups.size() && val <= groupData(id).capacity);
   _group_states[id].reduced_capacity = groupData(id).capacity - val;
+  updateSlotBonus(id);
 }
 
 void State::disableTypeSpecificAssignment(StudentID student) {
@@ -469,3 +895,7 @@ StudentID State::partIDToStudentID(ParticipantID id) const {
 std::mt19937_64& State::getRandomness() {
   return _random_gen;
 }
+
+void State::setRandomness(std::mt19937_64& random_gen) {
+  _random_gen = random_gen;
+}
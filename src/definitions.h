@@ -2,7 +2,11 @@
 
 #include <functional>
 #include <limits>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <random>
 
@@ -16,31 +20,46 @@
 #define RED "\033[1;91m"
 #define END "\033[0m"
 
-#define LOG(msg, verbosity) \
+// messages above this verbosity are removed at compile time, e.g. -DLOG_MAX_VERBOSITY=3 for production builds
+#ifndef LOG_MAX_VERBOSITY
+#define LOG_MAX_VERBOSITY 5
+#endif
+
+// the message is only formatted if the verbosity is enabled
+#define LOG_AS(kind, prefix, msg, verbosity) \
   do { \
-    if (Config::get().verbosity_level > 0 \
+    if ((verbosity) <= LOG_MAX_VERBOSITY && Config::get().verbosity_level > 0 \
         && (verbosity) <= Config::get().verbosity_level) { \
-      std::cout << msg << std::endl; \
+      std::ostringstream log_line; \
+      log_line << msg; \
+      writeLogLine(kind, verbosity, prefix, log_line.str()); \
     } \
   } while (false)
+#define LOG(msg, verbosity) LOG_AS("log", "", msg, verbosity)
 
-#define ERROR(msg, top_level) LOG(RED << "[ERROR]" << END << " " << msg, top_level ? 0 : 1)
-#define INFO(msg, top_level) LOG(GREEN << "[INFO]" << END << " " << msg, top_level ? 1 : 2)
-#define WARNING(msg, top_level) LOG(YELLOW << "[WARNING]" << END << " " << msg, top_level ? 1 : 2)
+#define ERROR(msg, top_level) LOG_AS("error", RED "[ERROR]" END " ", msg, top_level ? 0 : 1)
+#define INFO(msg, top_level) LOG_AS("info", GREEN "[INFO]" END " ", msg, top_level ? 1 : 2)
+#define WARNING(msg, top_level) LOG_AS("warning", YELLOW "[WARNING]" END " ", msg, top_level ? 1 : 2)
 
-#define MAJOR_PROGRESS(msg, top_level) LOG(GREEN << ">>" << END << " " << msg, top_level ? 1 : 2)
-#define PROGRESS(msg, top_level) LOG(GREEN << ">>" << END << " " << msg, top_level ? 2 : 3)
-#define TRACE_START CYAN << ">" << END << "  "
-#define MAJOR_TRACE(msg, top_level) LOG(TRACE_START << msg, top_level ? 2 : 3)
-#define TRACE(msg, top_level) LOG(TRACE_START << msg, top_level ? 3 : 4)
-#define DEBUG(msg) LOG(msg, 5)
+#define MAJOR_PROGRESS(msg, top_level) LOG_AS("progress", GREEN ">>" END " ", msg, top_level ? 1 : 2)
+#define PROGRESS(msg, top_level) LOG_AS("progress", GREEN ">>" END " ", msg, top_level ? 2 : 3)
+#define TRACE_START CYAN ">" END "  "
+#define MAJOR_TRACE(msg, top_level) LOG_AS("trace", TRACE_START, msg, top_level ? 2 : 3)
+#define TRACE(msg, top_level) LOG_AS("trace", TRACE_START, msg, top_level ? 3 : 4)
+#define DEBUG(msg) LOG_AS("debug", "", msg, 5)
 
-#define FATAL_ERROR(msg) std::cout << RED << "[ERROR]" << END << " " << msg << std::endl; std::exit(-1)
+#define FATAL_ERROR(msg) \
+  do { \
+    flushLog(); \
+    std::cout << RED << "[ERROR]" << END << " " << msg << std::endl; \
+    std::exit(-1); \
+  } while (false)
 
 #define __FILENAME__ (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
 #define ASSERT_WITH(cond, msg) \
   do { \
     if (!(cond)) { \
+      flushLog(); \
       std::cout << RED << "[ERROR]" << END << " Assertion at: " \
                 << __FILENAME__ << ":" << __LINE__ \
                 << " - `ASSERT(" << #cond << ")`" << std::endl; \
@@ -50,6 +69,34 @@
   } while (false)
 #define ASSERT(cond) ASSERT_WITH(cond, "")
 
+// receives each log line (without line break)
+using LogSink = std::function<void(const std::string&)>;
+
+// Redirects the log lines of the current thread while alive. The default writes to stdout from a background
+// thread, so logging threads don't wait for the terminal.
+// Tasks submitted to the thread pool inherit the sink of the submitting thread.
+class LogScope {
+ public:
+  explicit LogScope(const LogSink* sink);
+
+  ~LogScope();
+
+  LogScope(const LogScope&) = delete;
+  LogScope& operator=(const LogScope&) = delete;
+
+  // nullptr if no sink is active
+  static const LogSink* active();
+
+ private:
+  const LogSink* _previous;
+};
+
+// kind and verbosity are only used for --log-format=json, prefix is prepended to the text line
+void writeLogLine(const char* kind, uint32_t verbosity, const char* prefix, const std::string& message);
+
+// blocks until all pending log lines are written, required before writing to stdout directly
+void flushLog();
+
 
 // ####################################
 // ########     Input Data     ########
@@ -79,20 +126,99 @@ struct Rating {
   static Rating minRating(GroupID num_groups);
 };
 
-enum class CourseType {
+// Ratings of a participant for all groups. If only few groups are rated (top-k ratings), just these are
+// stored and all other groups have the default rating (invalid if there is none).
+class RatingList {
+ public:
+  RatingList() = default;
+
+  // one rating per group
+  RatingList(std::vector<Rating> ratings);
+
+  // the explicitly rated groups (in any order) and the rating of the remaining groups
+  RatingList(GroupID num_groups, std::vector<std::pair<GroupID, Rating>> rated, Rating default_rating = Rating());
+
+  Rating at(GroupID group) const;
+
+  Rating operator[](GroupID group) const;
+
+  // number of groups
+  GroupID size() const;
+
+  bool empty() const;
+
+  bool isSparse() const;
+
+  // replaces all missing ratings
+  void setDefault(Rating rating);
+
+  // true if every group has a valid rating
+  bool isComplete() const;
+
+  bool operator==(const RatingList &other) const;
+
+  // Visits all groups in ascending order with their rating, i.e. the rated entries and the default
+  // rating for the groups in between, without a lookup per group.
+  class Iterator {
+   public:
+    Iterator(const RatingList* list, GroupID group, size_t entry): _list(list), _group(group), _entry(entry) {}
+
+    std::pair<GroupID, Rating> operator*() const {
+      if (!_list->isSparse()) {
+        return {_group, _list->_dense[_group]};
+      }
+      const bool rated = _entry < _list->_sparse.size() && _list->_sparse[_entry].first == _group;
+      return {_group, rated ? _list->_sparse[_entry].second : _list->_default};
+    }
+
+    Iterator& operator++() {
+      if (_entry < _list->_sparse.size() && _list->_sparse[_entry].first == _group) {
+        ++_entry;
+      }
+      ++_group;
+      return *this;
+    }
+
+    bool operator!=(const Iterator& other) const {
+      return _group != other._group;
+    }
+
+   private:
+    const RatingList* _list;
+    GroupID _group;
+    size_t _entry;
+  };
+
+  Iterator begin() const {
+    return Iterator(this, 0, 0);
+  }
+
+  Iterator end() const {
+    return Iterator(this, _num_groups, _sparse.size());
+  }
+
+ private:
+  GroupID _num_groups = 0;
+  std::vector<Rating> _dense;
+  // sorted by group
+  std::vector<std::pair<GroupID, Rating>> _sparse;
+  Rating _default;
+};
+
+enum class CourseType : uint8_t {
   Info = 0,
   Mathe = 1,
   Lehramt = 2,
   Any = 3,
 };
 
-enum class DegreeType {
+enum class DegreeType : uint8_t {
   Bachelor = 0,
   Master = 1,
   Any = 2,
 };
 
-enum class Semester {
+enum class Semester : uint8_t {
   Ersti = 0,
   Dritti = 1,
 };
@@ -109,6 +235,8 @@ struct GroupData {
             StudentID min_target_size, CourseType ct, DegreeType dt);
 };
 
+// Ids and names are owned strings, so the data stays self-contained when it is copied between inputs
+// (library calls, server, sweep). The solver only uses the enums and indices.
 struct StudentData {
   std::string id;
   std::string name;
@@ -133,8 +261,11 @@ struct Input {
   std::vector<GroupData> groups;
   std::vector<StudentData> students;
   std::vector<TeamData> teams;
-  std::vector<std::vector<Rating>> ratings;
-  std::unordered_map<std::string, std::string> student_id_to_team_id;
+  std::vector<RatingList> ratings;
+  // index of the team of each student, -1 if none (might be shorter if the input is not parsed)
+  std::vector<int32_t> team_of_student;
+
+  int32_t teamOfStudent(StudentID student) const;
 };
 
 // #########################################
@@ -154,8 +285,6 @@ struct Filter {
   std::string name;
 };
 
-bool ratingsEqual(const std::vector<Rating> &r1, const std::vector<Rating> &r2);
-
 struct Participant {
   uint32_t index;
   bool is_team;
@@ -164,11 +293,27 @@ struct Participant {
   Participant(uint32_t index, bool is_team);
 };
 
+// Filters interned with small handles, together with the handles of the filters that apply to
+// each student as bitmask. Shared by copies of a state and copied on write.
+struct FilterRegistry {
+  static constexpr uint32_t MAX_FILTERS = 64;
+
+  std::vector<Filter> filters;
+  // the handle for each Filter::id(), so lookups don't recompute the ids of all filters
+  std::unordered_map<uint32_t, uint32_t> handle_of_id;
+  std::vector<uint64_t> student_masks;
+};
+
 struct GroupState {
   StudentID reduced_capacity = 0;
   bool enabled = true;
   uint32_t weight = 0;
-  std::vector<Filter> participant_filters;
+  // handles of the filters whose type specific students are excluded
+  uint64_t participant_filters = 0;
+  // prices per filter handle for type specific students matching the filter (negative values are a bonus)
+  std::vector<std::pair<uint32_t, int32_t>> participant_prices;
+  // bonus per free slot (see State::computeSlotBonus), empty if the group has no slot in the graph
+  std::vector<int32_t> slot_bonus;
 };
 
 // the state of the complete calculation
@@ -180,10 +325,23 @@ class State {
   std::vector<Participant> _participants;
   std::vector<bool> _type_specific_assignment;
   std::reference_wrapper<std::mt19937_64> _random_gen;
+  // previous group of each participant (-1 if none), only used in incremental mode
+  std::vector<int32_t> _previous_group;
+  uint32_t _move_penalty = 0;
+  std::shared_ptr<const FilterRegistry> _filter_registry;
 
 public:
   State(Input &data, std::mt19937_64& random_gen);
 
+  // Returns the reason why the constructor would reject the input (empty if it is valid), so that
+  // input from a client can be rejected without exiting
+  static std::string checkInput(const Input &data);
+
+  // Gradually increases the bonus so some of the slots in a group are better than others, which nudges the
+  // algorithm to distribute students more evenly among groups. Returns false if the min size is not
+  // significantly below the capacity, so that the ladder does not fit into the slots
+  static bool computeSlotBonus(StudentID capacity, StudentID min_size, std::vector<int32_t>& bonus);
+
   const Input &data() const;
 
   GroupID numGroups() const;
@@ -199,6 +357,9 @@ public:
 
   StudentID groupMinSize(GroupID id) const;
 
+  // bonus for each of the remaining slots of an enabled group
+  const std::vector<int32_t>& slotBonus(GroupID id) const;
+
   bool groupIsEnabled(GroupID id) const;
 
   const std::vector<std::pair<StudentID, ParticipantID>> &
@@ -225,7 +386,7 @@ public:
 
   GroupID assignment(ParticipantID id) const;
 
-  const std::vector<Rating> &rating(ParticipantID id) const;
+  const RatingList &rating(ParticipantID id) const;
 
   void disableGroup(GroupID id);
 
@@ -237,6 +398,20 @@ public:
 
   bool isExludedFromGroup(ParticipantID participant, GroupID group) const;
 
+  void setFilterPrice(GroupID id, const Filter& filter, int32_t price);
+
+  // sum of the prices of all type specific students of the participant
+  int32_t participantPrice(ParticipantID participant, GroupID group) const;
+
+  // Sets the previous group of each student (-1 if none). Teams use the group of their first
+  // member with a previous group. Assigning a participant to another group costs the penalty.
+  void setPreviousAssignment(const std::vector<int32_t>& previous_group, uint32_t move_penalty);
+
+  // -1 if none
+  int32_t previousGroup(ParticipantID participant) const;
+
+  uint32_t movePenalty(ParticipantID participant, GroupID group) const;
+
   bool assignParticipant(ParticipantID participant, GroupID target);
 
   void unassignParticipant(ParticipantID participant, GroupID group);
@@ -253,6 +428,18 @@ public:
 
   std::mt19937_64& getRandomness();
 
+  // required if the state is used in a different thread
+  void setRandomness(std::mt19937_64& random_gen);
+
  private:
   bool studentIsExludedFromGroup(StudentID participant, GroupID group) const;
+
+  // -1 if the filter is not registered
+  int32_t filterHandle(const Filter& filter) const;
+
+  uint32_t internFilter(const Filter& filter);
+
+  int32_t studentPrice(StudentID student, GroupID group) const;
+
+  void updateSlotBonus(GroupID id);
 };
\ No newline at end of file
@@ -0,0 +1,457 @@
+#include "exact.h"
+
+#include <boost/graph/adjacency_list.hpp>
+#include <boost/graph/maximum_weighted_matching.hpp>
+#include <chrono>
+#include <queue>
+
+#include "algorithms.h"
+#include "config.h"
+#include "thread_pool.h"
+
+using ExactEdgeProperty = boost::property<boost::edge_weight_t, int64_t>;
+using ExactGraph = boost::adjacency_list<boost::vecS, boost::vecS, boost::undirectedS,
+                                         boost::no_property, ExactEdgeProperty>;
+using ExactGraphTraits = boost::graph_traits<ExactGraph>;
+
+// ##########################################
+// ########     Helper Functions     ########
+// ##########################################
+
+std::vector<StudentID> participantMembers(const State &s, ParticipantID part) {
+  if (s.isTeam(part)) {
+    return s.teamData(part).members;
+  }
+  return {s.partIDToStudentID(part)};
+}
+
+int64_t participantWeight(const State &s, ParticipantID part, GroupID group) {
+  return static_cast<int64_t>(participantMembers(s, part).size())
+         * s.rating(part).at(group).getValue(s.numGroups());
+}
+
+// minimum size of a group that is not disabled
+StudentID exactMinSize(const State &s, GroupID group) {
+  return std::min(Config::get().group_disable_threshold, s.groupData(group).capacity);
+}
+
+// ####################################
+// ########    Linear Model    ########
+// ####################################
+
+LinearModel buildLinearModel(const State &s, const std::vector<std::pair<Filter, StudentID>>& filters) {
+  LinearModel model;
+  auto add_variable = [&](std::string name, int64_t objective) {
+    model.variables.push_back(std::move(name));
+    model.objective.push_back(objective);
+    return static_cast<uint32_t>(model.variables.size() - 1);
+  };
+  const int32_t invalid = -1;
+
+  // x_p_g: participant p is assigned to group g
+  std::vector<std::vector<int32_t>> x(s.numParticipants(), std::vector<int32_t>(s.numGroups(), invalid));
+  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+    for (GroupID group = 0; group < s.numGroups(); ++group) {
+      if (combinationIsValid(s, part, group)) {
+        x[part][group] = add_variable("x_" + std::to_string(part) + "_" + std::to_string(group),
+                                      participantWeight(s, part, group));
+      }
+    }
+  }
+  // y_g: group g is not disabled
+  std::vector<uint32_t> y;
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    y.push_back(add_variable("y_" + std::to_string(group), 0));
+  }
+
+  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+    LinearConstraint c{"assign_" + std::to_string(part), {}, Sense::Equal, 1};
+    for (GroupID group = 0; group < s.numGroups(); ++group) {
+      if (x[part][group] != invalid) {
+        c.terms.emplace_back(x[part][group], 1);
+      }
+    }
+    model.constraints.push_back(std::move(c));
+  }
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    LinearConstraint capacity{"capacity_" + std::to_string(group), {}, Sense::LessEqual, 0};
+    LinearConstraint min_size{"min_size_" + std::to_string(group), {}, Sense::GreaterEqual, 0};
+    for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+      if (x[part][group] != invalid) {
+        const int64_t size = participantMembers(s, part).size();
+        capacity.terms.emplace_back(x[part][group], size);
+        min_size.terms.emplace_back(x[part][group], size);
+      }
+    }
+    capacity.terms.emplace_back(y[group], -static_cast<int64_t>(s.groupData(group).capacity));
+    min_size.terms.emplace_back(y[group], -static_cast<int64_t>(exactMinSize(s, group)));
+    model.constraints.push_back(std::move(capacity));
+    model.constraints.push_back(std::move(min_size));
+  }
+
+  // z_i_g: group g contains type specific students of filter i
+  for (size_t i = 0; i < filters.size(); ++i) {
+    auto [filter, minimum] = filters[i];
+    for (GroupID group = 0; group < s.numGroups(); ++group) {
+      LinearConstraint type_min{"type_min_" + std::to_string(i) + "_" + std::to_string(group),
+                                {}, Sense::GreaterEqual, 0};
+      LinearConstraint type_ban{"type_ban_" + std::to_string(i) + "_" + std::to_string(group),
+                                {}, Sense::LessEqual, 0};
+      for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+        if (x[part][group] == invalid) {
+          continue;
+        }
+        int64_t num = 0;
+        int64_t num_type_specific = 0;
+        for (StudentID student: participantMembers(s, part)) {
+          if (filter.apply(s.data().students[student])) {
+            ++num;
+            if (s.typeSpecificAssignment(student)) {
+              ++num_type_specific;
+            }
+          }
+        }
+        if (num > 0) {
+          type_min.terms.emplace_back(x[part][group], num);
+        }
+        if (num_type_specific > 0) {
+          type_ban.terms.emplace_back(x[part][group], num_type_specific);
+        }
+      }
+      if (!type_ban.terms.empty()) {
+        uint32_t z = add_variable("z_" + std::to_string(i) + "_" + std::to_string(group), 0);
+        type_min.terms.emplace_back(z, -static_cast<int64_t>(minimum));
+        type_ban.terms.emplace_back(z, -static_cast<int64_t>(s.groupData(group).capacity));
+        model.constraints.push_back(std::move(type_min));
+        model.constraints.push_back(std::move(type_ban));
+      }
+    }
+  }
+  return model;
+}
+
+void writeLinearTerms(const LinearModel &model, const std::vector<std::pair<uint32_t, int64_t>>& terms,
+                      std::ostream& out) {
+  size_t written = 0;
+  for (const auto& [var, coeff]: terms) {
+    if (coeff == 0) {
+      continue;
+    }
+    if (written > 0 && written % 8 == 0) {
+      out << "\n   ";
+    }
+    out << (coeff < 0 ? " - " : " + ") << std::abs(coeff) << " " << model.variables[var];
+    ++written;
+  }
+  if (written == 0) {
+    out << " 0 " << model.variables[0];
+  }
+}
+
+void writeLP(const LinearModel &model, std::ostream& out) {
+  out << "\\ O-Phase group assignment\n";
+  out << "Maximize\n obj:";
+  std::vector<std::pair<uint32_t, int64_t>> objective;
+  for (uint32_t var = 0; var < model.variables.size(); ++var) {
+    objective.emplace_back(var, model.objective[var]);
+  }
+  writeLinearTerms(model, objective, out);
+  out << "\nSubject To\n";
+  for (const LinearConstraint& c: model.constraints) {
+    out << " " << c.name << ":";
+    writeLinearTerms(model, c.terms, out);
+    switch (c.sense) {
+      case Sense::LessEqual:
+        out << " <= ";
+        break;
+      case Sense::GreaterEqual:
+        out << " >= ";
+        break;
+      case Sense::Equal:
+        out << " = ";
+        break;
+    }
+    out << c.rhs << "\n";
+  }
+  out << "Binaries\n";
+  for (const std::string& var: model.variables) {
+    out << " " << var << "\n";
+  }
+  out << "End\n";
+}
+
+void writeMPS(const LinearModel &model, std::ostream& out) {
+  // MPS minimizes by default, therefore the objective is negated
+  out << "NAME ophase_group_assignment\n";
+  out << "ROWS\n N obj\n";
+  for (const LinearConstraint& c: model.constraints) {
+    const char type = (c.sense == Sense::LessEqual) ? 'L' : (c.sense == Sense::GreaterEqual ? 'G' : 'E');
+    out << " " << type << " " << c.name << "\n";
+  }
+
+  std::vector<std::vector<std::pair<size_t, int64_t>>> columns(model.variables.size());
+  for (size_t row = 0; row < model.constraints.size(); ++row) {
+    for (const auto& [var, coeff]: model.constraints[row].terms) {
+      columns[var].emplace_back(row, coeff);
+    }
+  }
+  out << "COLUMNS\n";
+  out << " MARKER 'MARKER' 'INTORG'\n";
+  for (uint32_t var = 0; var < model.variables.size(); ++var) {
+    if (model.objective[var] != 0) {
+      out << " " << model.variables[var] << " obj " << -model.objective[var] << "\n";
+    }
+    for (const auto& [row, coeff]: columns[var]) {
+      out << " " << model.variables[var] << " " << model.constraints[row].name << " " << coeff << "\n";
+    }
+  }
+  out << " MARKER 'MARKER' 'INTEND'\n";
+  out << "RHS\n";
+  for (const LinearConstraint& c: model.constraints) {
+    if (c.rhs != 0) {
+      out << " rhs " << c.name << " " << c.rhs << "\n";
+    }
+  }
+  out << "BOUNDS\n";
+  for (const std::string& var: model.variables) {
+    out << " BV bnd " << var << "\n";
+  }
+  out << "ENDATA\n";
+}
+
+// ####################################
+// ########  Branch and Bound  ########
+// ####################################
+
+enum class GroupDecision : uint8_t {
+  Undecided,
+  Disabled,
+  Opened
+};
+
+struct ExactNode {
+  std::vector<GroupDecision> decisions;
+  int64_t bound;
+
+  bool operator<(const ExactNode& other) const {
+    return bound < other.bound;
+  }
+};
+
+// Weighted matching where each participant occupies a single slot of its group. The edge weights
+// are shifted so that the matching first maximizes the number of matched participants, then the
+// number of filled forced slots (minimum size of opened groups) and only then the rating.
+std::pair<std::vector<int32_t>, bool> solveExactRelaxation(const State &s,
+    const std::vector<GroupDecision>& decisions, StudentID forced_slots, int64_t& objective) {
+  std::vector<GroupID> vertex_to_group;
+  std::vector<bool> vertex_is_forced;
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    if (decisions[group] != GroupDecision::Disabled) {
+      for (StudentID i = 0; i < s.groupData(group).capacity; ++i) {
+        vertex_to_group.push_back(group);
+        vertex_is_forced.push_back(decisions[group] == GroupDecision::Opened && i < forced_slots);
+      }
+    }
+  }
+  const size_t first_participant = vertex_to_group.size();
+  const size_t num_vertices = first_participant + s.numParticipants();
+
+  int64_t max_weight = 0;
+  int64_t total_weight = 0;
+  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+    int64_t max_for_part = 0;
+    for (GroupID group = 0; group < s.numGroups(); ++group) {
+      max_for_part = std::max(max_for_part, participantWeight(s, part, group));
+    }
+    max_weight = std::max(max_weight, max_for_part);
+    total_weight += max_for_part;
+  }
+  const int64_t forced_bonus = total_weight + 1;
+  const int64_t matched_bonus = (s.numParticipants() + 1) * (forced_bonus + max_weight) + 1;
+
+  ExactGraph g(num_vertices);
+  std::vector<ExactGraphTraits::vertex_descriptor> mates(num_vertices);
+  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+    for (size_t vertex = 0; vertex < first_participant; ++vertex) {
+      const GroupID group = vertex_to_group[vertex];
+      if (combinationIsValid(s, part, group) && !s.isExludedFromGroup(part, group)) {
+        int64_t weight = matched_bonus + participantWeight(s, part, group)
+                         + (vertex_is_forced[vertex] ? forced_bonus : 0);
+        add_edge(vertex, first_participant + part, ExactEdgeProperty(weight), g);
+      }
+    }
+  }
+  maximum_weighted_matching(g, &mates[0]);
+
+  std::vector<int32_t> assignment(s.numParticipants(), -1);
+  StudentID filled_forced = 0;
+  objective = 0;
+  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+    auto slot = mates[first_participant + part];
+    if (slot == ExactGraphTraits::null_vertex()) {
+      return {{}, false};
+    }
+    assignment[part] = vertex_to_group[slot];
+    objective += participantWeight(s, part, vertex_to_group[slot]);
+    if (vertex_is_forced[slot]) {
+      ++filled_forced;
+    }
+  }
+  StudentID required_forced = 0;
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    if (decisions[group] == GroupDecision::Opened) {
+      required_forced += std::min(forced_slots, s.groupData(group).capacity);
+    }
+  }
+  return {std::move(assignment), filled_forced == required_forced};
+}
+
+// whether the assignment is feasible for the exact model, also returns the number of students per group
+bool exactAssignmentIsFeasible(const State &s, const std::vector<std::pair<Filter, StudentID>>& filters,
+    const std::vector<int32_t>& assignment, std::vector<StudentID>& num_per_group) {
+  num_per_group.assign(s.numGroups(), 0);
+  std::vector<std::vector<StudentID>> num_for_filter(filters.size(), std::vector<StudentID>(s.numGroups(), 0));
+  std::vector<std::vector<StudentID>> num_type_specific(filters.size(), std::vector<StudentID>(s.numGroups(), 0));
+  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+    if (assignment[part] < 0) {
+      return false;
+    }
+    const GroupID group = assignment[part];
+    for (StudentID student: participantMembers(s, part)) {
+      num_per_group[group]++;
+      for (size_t i = 0; i < filters.size(); ++i) {
+        if (filters[i].first.apply(s.data().students[student])) {
+          num_for_filter[i][group]++;
+          if (s.typeSpecificAssignment(student)) {
+            num_type_specific[i][group]++;
+          }
+        }
+      }
+    }
+  }
+  bool feasible = true;
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    const StudentID num = num_per_group[group];
+    feasible &= (num <= s.groupData(group).capacity);
+    feasible &= (num == 0 || num >= exactMinSize(s, group));
+    for (size_t i = 0; i < filters.size(); ++i) {
+      const StudentID num_filtered = num_for_filter[i][group];
+      feasible &= (num_type_specific[i][group] == 0 || num_filtered >= filters[i].second);
+    }
+  }
+  return feasible;
+}
+
+ExactResult solveExact(const State &s, const std::vector<std::pair<Filter, StudentID>>& filters) {
+  std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+  ExactResult result;
+  std::vector<int32_t> heuristic_assignment(s.numParticipants(), -1);
+  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+    if (s.isAssigned(part)) {
+      heuristic_assignment[part] = s.assignment(part);
+      result.heuristic_objective += participantWeight(s, part, s.assignment(part));
+    }
+  }
+  std::vector<StudentID> num_per_group;
+  int64_t incumbent = std::numeric_limits<int64_t>::min();
+  if (exactAssignmentIsFeasible(s, filters, heuristic_assignment, num_per_group)) {
+    incumbent = result.heuristic_objective;
+  } else {
+    WARNING("Heuristic solution is infeasible for the exact model.", true);
+  }
+
+  // a team may fill more than one place, so the number of forced slots needs to be reduced accordingly
+  StudentID max_team_size = 1;
+  for (ParticipantID part = 0; part < s.numParticipants(); ++part) {
+    max_team_size = std::max<StudentID>(max_team_size, participantMembers(s, part).size());
+  }
+  const StudentID forced_slots = (Config::get().group_disable_threshold + max_team_size - 1) / max_team_size;
+
+  // groups disabled by the heuristic stay disabled
+  std::vector<GroupDecision> initial_decisions(s.numGroups(), GroupDecision::Undecided);
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    if (!s.groupIsEnabled(group)) {
+      initial_decisions[group] = GroupDecision::Disabled;
+    }
+  }
+  std::priority_queue<ExactNode> queue;
+  queue.push({std::move(initial_decisions), std::numeric_limits<int64_t>::max()});
+  int64_t unresolved_bound = std::numeric_limits<int64_t>::min();
+  while (!queue.empty() && result.num_nodes < Config::get().exact_node_limit && !cancellationRequested()) {
+    ExactNode node = queue.top();
+    queue.pop();
+    if (node.bound <= incumbent) {
+      continue;
+    }
+    ++result.num_nodes;
+
+    int64_t objective;
+    auto [assignment, success] = solveExactRelaxation(s, node.decisions, forced_slots, objective);
+    if (!success || objective <= incumbent) {
+      continue;
+    }
+    if (exactAssignmentIsFeasible(s, filters, assignment, num_per_group)) {
+      TRACE("New incumbent with weight " << objective << " (node " << result.num_nodes << ").", true);
+      incumbent = objective;
+      result.assignment = std::move(assignment);
+      continue;
+    }
+
+    // branch on the group with the smallest violation of the minimum size
+    GroupID branch_group = s.numGroups();
+    for (GroupID group = 0; group < s.numGroups(); ++group) {
+      if (node.decisions[group] == GroupDecision::Undecided && num_per_group[group] > 0
+          && num_per_group[group] < exactMinSize(s, group)
+          && (branch_group == s.numGroups() || num_per_group[group] < num_per_group[branch_group])) {
+        branch_group = group;
+      }
+    }
+    if (branch_group == s.numGroups()) {
+      // infeasible because of teams or types, which are not part of the relaxation
+      unresolved_bound = std::max(unresolved_bound, objective);
+      continue;
+    }
+    for (GroupDecision decision: {GroupDecision::Disabled, GroupDecision::Opened}) {
+      ExactNode child{node.decisions, objective};
+      child.decisions[branch_group] = decision;
+      queue.push(std::move(child));
+    }
+  }
+
+  result.upper_bound = std::max(incumbent, unresolved_bound);
+  if (!queue.empty()) {
+    result.upper_bound = std::max(result.upper_bound, queue.top().bound);
+  }
+  result.optimal = queue.empty() && unresolved_bound <= incumbent;
+  result.best_objective = std::max(incumbent, result.heuristic_objective);
+  if (incumbent <= result.heuristic_objective) {
+    result.assignment.clear();
+  }
+
+  const double gap = (result.upper_bound > 0) ?
+      100.0 * (result.upper_bound - result.heuristic_objective) / result.upper_bound : 0.0;
+  INFO("Exact mode: heuristic weight " << result.heuristic_objective << ", best weight " << result.best_objective
+       << ", upper bound " << result.upper_bound << " (gap " << gap << "%, " << result.num_nodes << " nodes, "
+       << std::chrono::duration<double>(std::chrono::system_clock::now() - start).count() << " s)", true);
+  if (result.optimal) {
+    PROGRESS("Exact mode: best weight is optimal.", true);
+  }
+  return result;
+}
+
+void applyExactSolution(State &s, const std::vector<std::pair<Filter, StudentID>>& filters) {
+  ExactResult exact = solveExact(s, filters);
+  if (!exact.assignment.empty()) {
+    State exact_state(s);
+    exact_state.reset();
+    const bool success = applyAssignment(exact_state, exact.assignment);
+    ASSERT(success);
+    // the model only counts students with type specific assignment
+    if (numTypeMinimumViolations(exact_state, filters) > numTypeMinimumViolations(s, filters)) {
+      WARNING("Exact solution has more type minimum violations than the heuristic solution and is discarded.", true);
+      return;
+    }
+    INFO("Exact solution improves the heuristic solution and is used instead.", true);
+    s = std::move(exact_state);
+  }
+}
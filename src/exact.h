@@ -0,0 +1,63 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+#include "definitions.h"
+
+// ####################################
+// ########    Linear Model    ########
+// ####################################
+
+enum class Sense {
+  LessEqual,
+  GreaterEqual,
+  Equal
+};
+
+struct LinearConstraint {
+  std::string name;
+  std::vector<std::pair<uint32_t, int64_t>> terms;
+  Sense sense;
+  int64_t rhs;
+};
+
+// binary program of the complete assignment problem (maximization)
+struct LinearModel {
+  std::vector<std::string> variables;
+  std::vector<int64_t> objective;
+  std::vector<LinearConstraint> constraints;
+};
+
+// Builds the exact model for the participants of the state. The model decides itself which groups
+// are disabled, i.e. disabled groups and filters of the state are ignored.
+LinearModel buildLinearModel(const State &s, const std::vector<std::pair<Filter, StudentID>>& filters);
+
+// CPLEX LP format
+void writeLP(const LinearModel &model, std::ostream& out);
+
+// free MPS format
+void writeMPS(const LinearModel &model, std::ostream& out);
+
+// ####################################
+// ########  Branch and Bound  ########
+// ####################################
+
+struct ExactResult {
+  int64_t heuristic_objective = 0;
+  int64_t best_objective = 0;
+  int64_t upper_bound = 0;
+  uint32_t num_nodes = 0;
+  bool optimal = false;
+  // assignment of the best solution found, empty if no solution improves the heuristic
+  std::vector<int32_t> assignment;
+};
+
+// Branch and bound on the group decisions (disabled or opened with minimum size), where each
+// node is bounded by a weighted matching. Type minima are only checked for the incumbent,
+// therefore the upper bound is valid but might not be tight. In contrast to the model, disabled
+// groups and filters of the state are kept, i.e. the bound refers to the decisions of the heuristic.
+ExactResult solveExact(const State &s, const std::vector<std::pair<Filter, StudentID>>& filters);
+
+// replaces the assignment of the state with the result of solveExact, if it is better
+void applyExactSolution(State &s, const std::vector<std::pair<Filter, StudentID>>& filters);
@@ -0,0 +1,171 @@
+#include "flow.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+
+#include "definitions.h"
+#include "thread_pool.h"
+
+MinCostFlow::MinCostFlow(size_t num_nodes): _outgoing(num_nodes) { }
+
+size_t MinCostFlow::addArc(size_t from, size_t to, int64_t capacity, int64_t cost) {
+  ASSERT(from < _outgoing.size() && to < _outgoing.size() && capacity >= 0 && cost >= 0);
+  const size_t index = _arcs.size();
+  _arcs.push_back({to, capacity, cost});
+  _arcs.push_back({from, 0, -cost});
+  _outgoing[from].push_back(index);
+  _outgoing[to].push_back(index + 1);
+  _capacity.push_back(capacity);
+  return index;
+}
+
+int64_t MinCostFlow::flow(size_t arc) const {
+  return _capacity[arc / 2] - _arcs[arc].residual;
+}
+
+int64_t MinCostFlow::solve(size_t source, size_t sink) {
+  constexpr int64_t INF = std::numeric_limits<int64_t>::max() / 4;
+  const size_t num_nodes = _outgoing.size();
+  // the costs are non-negative, so zero potentials are feasible in the beginning
+  std::vector<int64_t> potential(num_nodes, 0);
+  std::vector<int64_t> dist(num_nodes);
+  std::vector<size_t> incoming_arc(num_nodes);
+  using QueueEntry = std::pair<int64_t, size_t>;
+  int64_t total_flow = 0;
+
+  while (!cancellationRequested()) {
+    std::fill(dist.begin(), dist.end(), INF);
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+    dist[source] = 0;
+    queue.emplace(0, source);
+    while (!queue.empty()) {
+      const auto [node_dist, node] = queue.top();
+      queue.pop();
+      if (node_dist > dist[node]) {
+        continue;
+      }
+      for (size_t index : _outgoing[node]) {
+        const Arc& arc = _arcs[index];
+        if (arc.residual == 0) {
+          continue;
+        }
+        const int64_t new_dist = node_dist + arc.cost + potential[node] - potential[arc.to];
+        if (new_dist < dist[arc.to]) {
+          dist[arc.to] = new_dist;
+          incoming_arc[arc.to] = index;
+          queue.emplace(new_dist, arc.to);
+        }
+      }
+    }
+    if (dist[sink] == INF) {
+      break;
+    }
+    for (size_t node = 0; node < num_nodes; ++node) {
+      if (dist[node] < INF) {
+        potential[node] += dist[node];
+      }
+    }
+
+    // augment along the shortest path by its bottleneck
+    int64_t amount = INF;
+    for (size_t node = sink; node != source; node = _arcs[incoming_arc[node] ^ 1].to) {
+      amount = std::min(amount, _arcs[incoming_arc[node]].residual);
+    }
+    for (size_t node = sink; node != source; node = _arcs[incoming_arc[node] ^ 1].to) {
+      _arcs[incoming_arc[node]].residual -= amount;
+      _arcs[incoming_arc[node] ^ 1].residual += amount;
+    }
+    total_flow += amount;
+  }
+  return total_flow;
+}
+
+MaxFlow::MaxFlow(size_t num_nodes): _outgoing(num_nodes) { }
+
+size_t MaxFlow::addArc(size_t from, size_t to, int64_t capacity) {
+  ASSERT(from < _outgoing.size() && to < _outgoing.size() && capacity >= 0);
+  const size_t index = _arcs.size();
+  _arcs.push_back({to, capacity});
+  _arcs.push_back({from, 0});
+  _outgoing[from].push_back(index);
+  _outgoing[to].push_back(index + 1);
+  _capacity.push_back(capacity);
+  return index;
+}
+
+int64_t MaxFlow::flow(size_t arc) const {
+  return _capacity[arc / 2] - _arcs[arc].residual;
+}
+
+bool MaxFlow::buildLevels(size_t source, size_t sink) {
+  constexpr uint32_t UNREACHED = std::numeric_limits<uint32_t>::max();
+  _level.assign(_outgoing.size(), UNREACHED);
+  std::queue<size_t> queue;
+  _level[source] = 0;
+  queue.push(source);
+  while (!queue.empty()) {
+    const size_t node = queue.front();
+    queue.pop();
+    for (size_t arc : _outgoing[node]) {
+      const Arc& a = _arcs[arc];
+      if (a.residual > 0 && _level[a.to] == UNREACHED) {
+        _level[a.to] = _level[node] + 1;
+        queue.push(a.to);
+      }
+    }
+  }
+  return _level[sink] != UNREACHED;
+}
+
+int64_t MaxFlow::augment(size_t node, size_t sink, int64_t limit) {
+  if (node == sink) {
+    return limit;
+  }
+  for (size_t& i = _next_arc[node]; i < _outgoing[node].size(); ++i) {
+    const size_t arc = _outgoing[node][i];
+    Arc& a = _arcs[arc];
+    if (a.residual > 0 && _level[a.to] == _level[node] + 1) {
+      const int64_t pushed = augment(a.to, sink, std::min(limit, a.residual));
+      if (pushed > 0) {
+        a.residual -= pushed;
+        _arcs[arc ^ 1].residual += pushed;
+        return pushed;
+      }
+    }
+  }
+  return 0;
+}
+
+int64_t MaxFlow::solve(size_t source, size_t sink) {
+  constexpr int64_t INF = std::numeric_limits<int64_t>::max();
+  int64_t total_flow = 0;
+  while (buildLevels(source, sink)) {
+    _next_arc.assign(_outgoing.size(), 0);
+    while (const int64_t pushed = augment(source, sink, INF)) {
+      total_flow += pushed;
+    }
+  }
+  return total_flow;
+}
+
+std::vector<bool> MaxFlow::sourceSide(size_t source) const {
+  std::vector<bool> reachable(_outgoing.size(), false);
+  std::vector<size_t> stack{source};
+  reachable[source] = true;
+  while (!stack.empty()) {
+    const size_t node = stack.back();
+    stack.pop_back();
+    for (size_t arc : _outgoing[node]) {
+      const Arc& a = _arcs[arc];
+      if (a.residual > 0 && !reachable[a.to]) {
+        reachable[a.to] = true;
+        stack.push_back(a.to);
+      }
+    }
+  }
+  return reachable;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ####################################
+// ########   Min Cost Flow    ########
+// ####################################
+
+// Minimum cost maximum flow via successive shortest paths (Dijkstra with potentials).
+// All arc costs must be non-negative.
+class MinCostFlow {
+ public:
+  explicit MinCostFlow(size_t num_nodes);
+
+  // returns the index of the arc
+  size_t addArc(size_t from, size_t to, int64_t capacity, int64_t cost);
+
+  // Sends as much flow as possible from source to sink with minimum total cost and returns the
+  // amount of flow. Stops early if cancellation is requested.
+  int64_t solve(size_t source, size_t sink);
+
+  int64_t flow(size_t arc) const;
+
+ private:
+  struct Arc {
+    size_t to;
+    int64_t residual;
+    int64_t cost;
+  };
+
+  // the reverse of arc i is arc i ^ 1
+  std::vector<Arc> _arcs;
+  std::vector<std::vector<size_t>> _outgoing;
+  std::vector<int64_t> _capacity;
+};
+
+// ####################################
+// ########      Max Flow      ########
+// ####################################
+
+// Maximum flow via blocking flows on the BFS level graph (Dinic). On unit capacity bipartite graphs,
+// this is the Hopcroft-Karp algorithm.
+class MaxFlow {
+ public:
+  explicit MaxFlow(size_t num_nodes);
+
+  // returns the index of the arc
+  size_t addArc(size_t from, size_t to, int64_t capacity);
+
+  // returns the amount of flow from source to sink
+  int64_t solve(size_t source, size_t sink);
+
+  int64_t flow(size_t arc) const;
+
+  // After solving: the nodes reachable from the source in the residual graph, i.e. the source side of
+  // a minimum cut.
+  std::vector<bool> sourceSide(size_t source) const;
+
+ private:
+  struct Arc {
+    size_t to;
+    int64_t residual;
+  };
+
+  bool buildLevels(size_t source, size_t sink);
+
+  int64_t augment(size_t node, size_t sink, int64_t limit);
+
+  // the reverse of arc i is arc i ^ 1
+  std::vector<Arc> _arcs;
+  std::vector<std::vector<size_t>> _outgoing;
+  std::vector<int64_t> _capacity;
+  std::vector<uint32_t> _level;
+  std::vector<size_t> _next_arc;
+};
@@ -0,0 +1,63 @@
+#include "group_assignment.h"
+
+#include <algorithm>
+#include <optional>
+#include <random>
+
+#include "algorithms.h"
+#include "exact.h"
+#include "thread_pool.h"
+
+AssignmentResult runAssignment(const Input &input, const std::vector<std::pair<Filter, StudentID>>& type_filters,
+                               const Config& options, const LogSink& log_sink) {
+  Config::Scope config_scope(&options);
+  LogScope log_scope(&log_sink);
+  AssignmentResult result;
+  result.message = Config::validate();
+  if (result.message.empty()) {
+    result.message = State::checkInput(input);
+  }
+  if (!result.message.empty()) {
+    return result;
+  }
+
+  std::optional<DeadlineScope> deadline_scope;
+  if (options.time_limit > 0) {
+    deadline_scope.emplace(deadlineAfter(options.time_limit));
+  }
+
+  std::mt19937_64 random_gen(options.random_seed);
+  // the state sanitizes the ratings and team data of its input
+  Input data(input);
+  State state(data, random_gen);
+  if (!assignWithMinimumNumberPerGroup(state, options.group_disable_threshold)) {
+    result.message = "Could not calculate an assignment";
+    return result;
+  }
+  assertTypeMinima(state, type_filters);
+  if (options.exact_solve) {
+    applyExactSolution(state, type_filters);
+  }
+
+  result.success = true;
+  result.time_limit_reached = deadlineReached();
+  for (ParticipantID part = 0; part < state.numParticipants(); ++part) {
+    result.assignment.push_back(state.isAssigned(part) ? static_cast<int32_t>(state.assignment(part)) : -1);
+  }
+  result.total_weight = totalWeight(state);
+  for (const auto& violations: typeMinimumViolations(state, type_filters)) {
+    result.num_type_minimum_violations += violations.size();
+  }
+  result.num_active_groups = state.numActiveGroups();
+  uint64_t rating_sum = 0;
+  for (ParticipantID part = 0; part < state.numParticipants(); ++part) {
+    if (!state.isAssigned(part)) {
+      continue;
+    }
+    const StudentID size = state.isTeam(part) ? state.teamData(part).size() : 1;
+    rating_sum += static_cast<uint64_t>(size) * state.rating(part).at(state.assignment(part)).index;
+  }
+  result.average_rating = static_cast<double>(rating_sum) / std::max<size_t>(1, state.numStudents());
+  result.output = writeOutputToTree(state);
+  return result;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "definitions.h"
+#include "io.h"
+
+// ####################################
+// ########    Library API     ########
+// ####################################
+
+struct AssignmentResult {
+  bool success = false;
+  // reason if the calculation failed, e.g. invalid options or input
+  std::string message;
+  // group of each participant of the state (see State), -1 if not assigned
+  std::vector<int32_t> assignment;
+  uint64_t total_weight = 0;
+  size_t num_type_minimum_violations = 0;
+  GroupID num_active_groups = 0;
+  // mean rating index of the assigned group per student (0 is the best rating)
+  double average_rating = 0;
+  // the calculation was stopped by --time-limit, i.e. the assignment is the best one found so far
+  bool time_limit_reached = false;
+  // same format as the output file of the command line tool
+  PTree output;
+};
+
+// Calculates the complete assignment (minimum group sizes, type minima and optionally the exact
+// solver) without using the global state: options are taken from `options` and log lines are
+// passed to `log_sink` (stdout if empty). Therefore, multiple assignments can run concurrently.
+// The input is copied, so it can be shared between concurrent calls. Invalid options or input
+// are reported via `AssignmentResult::message` instead of exiting.
+// Note that parseInput reads options as well, i.e. it should be called within a Config::Scope.
+AssignmentResult runAssignment(const Input &input, const std::vector<std::pair<Filter, StudentID>>& type_filters,
+                               const Config& options, const LogSink& log_sink = {});
@@ -1,10 +1,12 @@
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <unordered_map>
 #include <unordered_set>
 
 #include "io.h"
 #include "config.h"
+#include "thread_pool.h"
 
 template <typename T, typename F>
 std::vector<T> parseList(const PTree &tree, F fn) {
@@ -15,16 +17,17 @@ std::vector<T> parseList(const PTree &tree, F fn) {
   return result;
 }
 
+// the keys are views of the ids, so the list must not change while the mapping is used
 template <typename T>
-std::unordered_map<std::string, size_t> createMapping(const std::vector<T> &list) {
-  std::unordered_map<std::string, size_t> result;
+std::unordered_map<std::string_view, size_t> createMapping(const std::vector<T> &list) {
+  std::unordered_map<std::string_view, size_t> result;
   for (size_t i = 0; i < list.size(); ++i) {
     result.insert({list[i].id, i});
   }
   return result;
 }
 
-CourseType parseCourseType(const std::string& name) {
+std::optional<CourseType> courseTypeFromString(const std::string& name) {
   if (name == "info") {
     return CourseType::Info;
   } else if (name == "mathe") {
@@ -33,49 +36,72 @@ CourseType parseCourseType(const std::string& name) {
     return CourseType::Lehramt;
   } else if (name == "any") {
     return CourseType::Any;
-  } else {
-    FATAL_ERROR("Invalid course type: " << name);
   }
+  return std::nullopt;
 }
 
-DegreeType parseDegreeType(const std::string& name) {
+std::optional<DegreeType> degreeTypeFromString(const std::string& name) {
   if (name == "bachelor") {
     return DegreeType::Bachelor;
   } else if (name == "master") {
     return DegreeType::Master;
   } else if (name == "any") {
     return DegreeType::Any;
-  } else {
-    FATAL_ERROR("Invalid degree type: " << name);
   }
+  return std::nullopt;
 }
 
-Semester parseSemester(const std::string& name) {
+std::optional<Semester> semesterFromString(const std::string& name) {
   if (name == "ersti") {
     return Semester::Ersti;
   } else if (name == "dritti") {
     return Semester::Dritti;
-  } else {
+  }
+  return std::nullopt;
+}
+
+CourseType parseCourseType(const std::string& name) {
+  const auto type = courseTypeFromString(name);
+  if (!type) {
+    FATAL_ERROR("Invalid course type: " << name);
+  }
+  return *type;
+}
+
+DegreeType parseDegreeType(const std::string& name) {
+  const auto type = degreeTypeFromString(name);
+  if (!type) {
+    FATAL_ERROR("Invalid degree type: " << name);
+  }
+  return *type;
+}
+
+Semester parseSemester(const std::string& name) {
+  const auto semester = semesterFromString(name);
+  if (!semester) {
     FATAL_ERROR("Invalid semseter: " << name);
   }
+  return *semester;
 }
 
-TeamData parseTeam(const std::string team_id, const PTree &tree, const std::unordered_map<std::string, size_t>& student_id_to_index,
-                   std::unordered_map<std::string, std::string>& student_id_to_team_id) {
+TeamData parseTeam(const std::string team_id, int32_t team_index, const PTree &tree,
+                   const std::unordered_map<std::string_view, size_t>& student_id_to_index,
+                   std::vector<int32_t>& team_of_student) {
   std::vector<StudentID> members =
     parseList<StudentID>(tree, [&](const auto &t) {
       std::string id = t.second.PTree::template get_value<std::string>();
       ASSERT_WITH(student_id_to_index.find(id) != student_id_to_index.end(), "Invalid student id in team: " << id);
-      ASSERT_WITH(student_id_to_team_id.find(id) == student_id_to_team_id.end(),
-                  std::string("Student contained in more than one team: ") << id);
-      student_id_to_team_id[id] = team_id;
-      return student_id_to_index.at(t.second.PTree::template get_value<std::string>());
+      const StudentID student = student_id_to_index.at(id);
+      ASSERT_WITH(team_of_student[student] < 0, std::string("Student contained in more than one team: ") << id);
+      team_of_student[student] = team_index;
+      return student;
     });
   return TeamData(team_id, members);
 }
 
-std::vector<Rating> parseRatings(const PTree &tree, const std::unordered_map<std::string, size_t>& group_id_to_index, size_t num_groups) {
-  std::vector<Rating> result(num_groups);
+// only the rated groups are stored, so top-k ratings stay small for many groups
+RatingList parseRatings(const PTree &tree, const std::unordered_map<std::string_view, size_t>& group_id_to_index, size_t num_groups) {
+  std::vector<std::pair<GroupID, Rating>> rated;
   auto get_index = [&](const std::string& group_id) {
     ASSERT_WITH(group_id_to_index.find(group_id) != group_id_to_index.end(),
                 "Invalid group id in rating: " << group_id << " - Is --rating-input-type correctly specified?");
@@ -88,52 +114,65 @@ std::vector<Rating> parseRatings(const PTree &tree, const std::unordered_map<std
         return t.second.PTree::template get_value<std::string>();
       });
     for (size_t i = 0; i < group_order.size(); ++i) {
-      size_t group_index = get_index(group_order[i]);
-      result[group_index] = Rating(i);
+      rated.emplace_back(get_index(group_order[i]), Rating(i));
     }
   } else {
     ASSERT(Config::get().rating_input_type == RatingInputType::Mapping);
     for(const auto& element: tree) {
-      size_t group_index = get_index(element.first);
-      result[group_index] = Rating(element.second.PTree::get_value<size_t>());
+      rated.emplace_back(get_index(element.first), Rating(element.second.PTree::get_value<size_t>()));
     }
   }
-  return result;
+  return RatingList(num_groups, std::move(rated));
+}
+
+GroupData parseGroup(const std::string& id, const PTree &tree) {
+  std::string name = tree.get<std::string>("name");
+  StudentID capacity = tree.get<StudentID>("capacity");
+  StudentID min_target_size = Config::get().allowMinGroupSizeDefault() ?
+                              tree.get<StudentID>("min_size", capacity / 2) : tree.get<StudentID>("min_size");
+  CourseType course_type = parseCourseType(tree.get<std::string>("course_type", "any"));
+  DegreeType degree_type = parseDegreeType(tree.get<std::string>("degree_type", "any"));
+  return GroupData(id, name, capacity, min_target_size, course_type, degree_type);
+}
+
+StudentData parseStudent(const std::string& id, const PTree &tree) {
+  std::string name = tree.get<std::string>("name");
+  CourseType course_type = parseCourseType(tree.get<std::string>("course_type"));
+  DegreeType degree_type = parseDegreeType(tree.get<std::string>("degree_type"));
+  Semester semester = parseSemester(tree.get<std::string>("semester", "ersti"));
+  bool type_specific_assignment = tree.get<bool>("type_specific_assignment", true);
+  return StudentData(id, name, course_type, degree_type, semester, type_specific_assignment);
 }
 
 Input parseInput(const PTree &tree) {
   Input input;
-  auto parseGroup = [](auto element){
-    std::string id = element.first;
-    PTree tree = element.second;
-    std::string name = tree.get<std::string>("name");
-    StudentID capacity = tree.get<StudentID>("capacity");
-    StudentID min_target_size = Config::get().allow_min_group_size_default ?
-                                tree.get<StudentID>("min_size", capacity / 2) : tree.get<StudentID>("min_size");
-    CourseType course_type = parseCourseType(tree.get<std::string>("course_type", "any"));
-    DegreeType degree_type = parseDegreeType(tree.get<std::string>("degree_type", "any"));
-    return GroupData(id, name, capacity, min_target_size, course_type, degree_type);
-  };
-  auto parseStudent = [](auto element){
-    std::string id = element.first;
-    PTree tree = element.second;
-    std::string name = tree.get<std::string>("name");
-    CourseType course_type = parseCourseType(tree.get<std::string>("course_type"));
-    DegreeType degree_type = parseDegreeType(tree.get<std::string>("degree_type"));
-    Semester semester = parseSemester(tree.get<std::string>("semester", "ersti"));
-    bool type_specific_assignment = tree.get<bool>("type_specific_assignment", true);
-    return StudentData(id, name, course_type, degree_type, semester, type_specific_assignment);
-  };
-  input.groups = parseList<GroupData>(tree.find("groups")->second, parseGroup);
+  input.groups = parseList<GroupData>(tree.find("groups")->second, [](const auto &t) {
+    return parseGroup(t.first, t.second);
+  });
+  extendInput(input, tree);
+  return input;
+}
+
+void extendInput(Input &input, const PTree &tree) {
   auto group_mapping = createMapping(input.groups);
-  input.students = parseList<StudentData>(tree.find("students")->second, parseStudent);
+  if (tree.find("students") != tree.not_found()) {
+    for (const auto &t : tree.find("students")->second) {
+      input.students.push_back(parseStudent(t.first, t.second));
+    }
+  }
   auto student_mapping = createMapping(input.students);
-  input.teams = parseList<TeamData>(tree.find("teams")->second,
-    [&](const auto &t) {
-      return parseTeam(t.first, t.second, student_mapping, input.student_id_to_team_id);
-    });
+  ASSERT_WITH(student_mapping.size() == input.students.size(), "Student ids must be unique");
+  input.team_of_student.resize(input.students.size(), -1);
+  if (tree.find("teams") != tree.not_found()) {
+    for (const auto &t : tree.find("teams")->second) {
+      input.teams.push_back(parseTeam(t.first, input.teams.size(), t.second, student_mapping, input.team_of_student));
+    }
+  }
   auto team_mapping = createMapping(input.teams);
-  std::vector<std::vector<Rating>> ratings(input.students.size());
+  input.ratings.resize(input.students.size());
+  if (tree.find("ratings") == tree.not_found()) {
+    return;
+  }
   for (auto &element : tree.find("ratings")->second) {
     auto rating_list = parseRatings(element.second, group_mapping, input.groups.size());
     if (Config::get().input_per_team) {
@@ -142,43 +181,156 @@ Input parseInput(const PTree &tree) {
                   "If so, you probably want to use --input-per-team=false");
       const TeamData& team = input.teams[team_mapping.at(element.first)];
       for (StudentID student: team.members) {
-        ratings[student] = rating_list;
+        input.ratings[student] = rating_list;
       }
     } else {
       ASSERT_WITH(student_mapping.find(element.first) != student_mapping.end(),
                   "Student \"" << element.first << "\" not found. Is this a team id? "
                   "If so, you probably want to use --input-per-team=true");
-      ratings[student_mapping.at(element.first)] = rating_list;
+      input.ratings[student_mapping.at(element.first)] = rating_list;
+    }
+  }
+}
+
+std::string checkInputExtension(const Input &input, const PTree &tree) {
+  std::unordered_set<std::string> student_ids;
+  for (const StudentData& student : input.students) {
+    student_ids.insert(std::string(student.id));
+  }
+  if (tree.find("students") != tree.not_found()) {
+    for (const auto &t : tree.find("students")->second) {
+      if (!student_ids.insert(t.first).second) {
+        return "Student ids must be unique: " + t.first;
+      }
+      if (!courseTypeFromString(t.second.get<std::string>("course_type"))
+          || !degreeTypeFromString(t.second.get<std::string>("degree_type"))
+          || !semesterFromString(t.second.get<std::string>("semester", "ersti"))) {
+        return "Invalid student type: " + t.first;
+      }
+    }
+  }
+  std::unordered_set<std::string> team_ids, team_members;
+  for (const TeamData& team : input.teams) {
+    team_ids.insert(std::string(team.id));
+    for (StudentID member : team.members) {
+      team_members.insert(std::string(input.students[member].id));
+    }
+  }
+  if (tree.find("teams") != tree.not_found()) {
+    for (const auto &t : tree.find("teams")->second) {
+      team_ids.insert(t.first);
+      for (const auto &member : t.second) {
+        const std::string id = member.second.get_value<std::string>();
+        if (student_ids.count(id) == 0) {
+          return "Invalid student id in team: " + id;
+        } else if (!team_members.insert(id).second) {
+          return "Student contained in more than one team: " + id;
+        }
+      }
+    }
+  }
+  if (tree.find("ratings") == tree.not_found()) {
+    return "";
+  }
+  auto group_mapping = createMapping(input.groups);
+  for (const auto &element : tree.find("ratings")->second) {
+    const auto& ids = Config::get().input_per_team ? team_ids : student_ids;
+    if (ids.count(element.first) == 0) {
+      return "Rating for unknown " + std::string(Config::get().input_per_team ? "team" : "student")
+             + ": " + element.first;
+    }
+    for (const auto &rating : element.second) {
+      const std::string group_id = Config::get().rating_input_type == RatingInputType::OrderedList
+                                   ? rating.second.get_value<std::string>() : rating.first;
+      if (group_mapping.find(group_id) == group_mapping.end()) {
+        return "Invalid group id in rating: " + group_id;
+      }
     }
   }
+  return "";
+}
+
+void removeFromInput(Input &input, const std::vector<std::string> &student_ids) {
+  std::unordered_set<std::string_view> removed(student_ids.begin(), student_ids.end());
+  std::vector<int64_t> new_index(input.students.size(), -1);
+  std::vector<StudentData> students;
+  std::vector<RatingList> ratings;
+  for (StudentID student = 0; student < input.students.size(); ++student) {
+    if (removed.count(input.students[student].id) == 0) {
+      new_index[student] = students.size();
+      students.push_back(std::move(input.students[student]));
+      ratings.push_back(std::move(input.ratings[student]));
+    }
+  }
+  std::vector<TeamData> teams;
+  std::vector<int32_t> team_of_student(students.size(), -1);
+  for (TeamData& team : input.teams) {
+    std::vector<StudentID> members;
+    for (StudentID member : team.members) {
+      if (new_index[member] >= 0) {
+        members.push_back(new_index[member]);
+        team_of_student[new_index[member]] = teams.size();
+      }
+    }
+    if (!members.empty()) {
+      teams.emplace_back(team.id, std::move(members));
+    }
+  }
+  input.students = std::move(students);
   input.ratings = std::move(ratings);
-  return input;
+  input.teams = std::move(teams);
+  input.team_of_student = std::move(team_of_student);
+}
+
+std::vector<int32_t> parsePreviousAssignment(const Input &input, const PTree &tree) {
+  auto group_mapping = createMapping(input.groups);
+  auto student_mapping = createMapping(input.students);
+  auto team_mapping = createMapping(input.teams);
+  std::vector<int32_t> result(input.students.size(), -1);
+  for (const auto &element : tree) {
+    auto group = group_mapping.find(element.second.get_value<std::string>());
+    if (group == group_mapping.end()) {
+      TRACE("Previous group of \"" << element.first << "\" does not exist anymore.", true);
+      continue;
+    }
+    if (student_mapping.find(element.first) != student_mapping.end()) {
+      result[student_mapping.at(element.first)] = group->second;
+    } else if (team_mapping.find(element.first) != team_mapping.end()) {
+      for (StudentID member : input.teams[team_mapping.at(element.first)].members) {
+        result[member] = group->second;
+      }
+    } else {
+      TRACE("Previously assigned \"" << element.first << "\" is not contained in the input.", true);
+    }
+  }
+  return result;
 }
 
 PTree writeOutputToTree(const State &s) {
   PTree root;
-  std::unordered_set<std::string> considered_students;
+  std::unordered_set<std::string_view> considered_students;
   for (StudentID participant = 0; participant < s.numParticipants(); ++participant) {
     std::string group_id = s.groupData(s.getAssignment(participant)).id;
     if (Config::get().output_per_team) {
-      std::string team_id;
+      std::string_view team_id;
       if (s.isTeam(participant)) {
         team_id = s.teamData(participant).id;
       } else {
-        const std::string student_id = s.studentData(participant).id;
-        team_id = s.data().student_id_to_team_id.at(student_id);
+        const int32_t team = s.data().teamOfStudent(s.partIDToStudentID(participant));
+        ASSERT(team >= 0);
+        team_id = s.data().teams[team].id;
       }
-      root.put<std::string>(team_id, group_id);
+      root.put<std::string>(std::string(team_id), group_id);
     } else {
       if (s.isTeam(participant)) {
         for (StudentID member : s.teamData(participant).members) {
-          const std::string student_id = s.data().students[member].id;
-          root.put<std::string>(student_id, group_id);
+          const std::string_view student_id = s.data().students[member].id;
+          root.put<std::string>(std::string(student_id), group_id);
           considered_students.insert(student_id);
         }
       } else {
-        const std::string student_id = s.studentData(participant).id;
-        root.put<std::string>(student_id, group_id);
+        const std::string_view student_id = s.studentData(participant).id;
+        root.put<std::string>(std::string(student_id), group_id);
         considered_students.insert(student_id);
       }
     }
@@ -225,56 +377,133 @@ std::string semesterToString(Semester semester) {
   }
 }
 
-void outputStudentDataToFile(const StudentData& data,  const std::string &rating, std::ofstream& file) {
-  file << data.name << ", " << data.id << ", " << courseTypeToString(data.course_type)
-       << ", " << degreeTypeToString(data.degree_type) << ", " << semesterToString(data.semester)
-       << ", [" << rating << "]" << std::endl;
+// appends name, id and types of the student
+void appendStudentData(const StudentData& data, std::string& out) {
+  out += data.name;
+  out += ", ";
+  out += data.id;
+  out += ", ";
+  out += courseTypeToString(data.course_type);
+  out += ", ";
+  out += degreeTypeToString(data.degree_type);
+  out += ", ";
+  out += semesterToString(data.semester);
+}
+
+// appends the field as in RFC 4180, i.e. quoted if it contains a separator, quote or line break
+void appendCsvField(const std::string& field, std::string& out) {
+  if (field.find_first_of(",\"\r\n") == std::string::npos) {
+    out += field;
+    return;
+  }
+  out += '"';
+  for (char c : field) {
+    if (c == '"') {
+      out += '"';
+    }
+    out += c;
+  }
+  out += '"';
+}
+
+void appendCsvRow(const std::vector<std::string>& fields, std::string& out) {
+  for (size_t i = 0; i < fields.size(); ++i) {
+    if (i > 0) {
+      out += ',';
+    }
+    appendCsvField(fields[i], out);
+  }
+  out += '\n';
 }
 
-// Writes the output in (more) human-readable form to the specified path
+// content of the group file (or rows of Groups.csv) and number of students per type filter
+struct GroupReport {
+  std::string content;
+  std::vector<StudentID> num_per_type;
+};
+
+// Writes the output in (more) human-readable form to the specified path. The reports of the groups are
+// created in parallel and written as one file per group or as a single Groups.csv
 void writeOutputToFiles(const State &s, std::string path,
     const std::vector<std::pair<Filter, StudentID>> &filters) {
+  const bool single_file = (Config::get().group_report_format == GroupReportFormat::Csv);
+  std::vector<std::string> group_name_ids;
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    group_name_ids.push_back(s.groupData(group).name + "-" + s.groupData(group).id.substr(0, 5));
+  }
+
+  std::vector<GroupReport> reports(s.numGroups());
+  TaskGroup tasks;
+  for (GroupID group = 0; group < s.numGroups(); ++group) {
+    if (s.groupAssignmentList(group).empty()) {
+      continue;
+    }
+    tasks.run([&, group] {
+      GroupReport& report = reports[group];
+      report.num_per_type.resize(filters.size());
+      for (const auto &pair : s.groupAssignmentList(group)) {
+        const StudentData& data = s.data().students[pair.first];
+        const std::string rating = s.rating(pair.second)[group].getName();
+        if (single_file) {
+          appendCsvRow({group_name_ids[group], data.name, data.id, courseTypeToString(data.course_type),
+                        degreeTypeToString(data.degree_type), semesterToString(data.semester), rating},
+                       report.content);
+        } else {
+          appendStudentData(data, report.content);
+          report.content += ", [" + rating + "]\n";
+        }
+        for (size_t i = 0; i < filters.size(); ++i) {
+          if (filters[i].first.apply(data)) {
+            ++report.num_per_type[i];
+          }
+        }
+      }
+      if (!single_file) {
+        std::ofstream file(path + "/" + group_name_ids[group]);
+        file << report.content;
+        report.content = std::string();
+      }
+    });
+  }
+  if (!tasks.wait()) {
+    ERROR("Writing the group reports was interrupted.", true);
+    return;
+  }
+
   std::string removed_path = path + "/RemovedGroups";
   std::ofstream removed(removed_path);
   std::string stats_path = path + "/Stats.csv";
   std::ofstream stats(stats_path);
+  std::ofstream groups_csv;
+  if (single_file) {
+    groups_csv.open(path + "/Groups.csv");
+    groups_csv << "Group,Name,ID,Course,Degree,Semester,Rating\n";
+  }
 
   // csv header
   std::string header = "Name, Size, ";
   for (size_t i = 0; i < filters.size(); ++i) {
     header += filters[i].first.name + (i + 1 == filters.size() ? "" : ", ");
   }
-  stats << header << std::endl;
+  stats << header << "\n";
 
   StudentID sum = 0;
   std::vector<StudentID> filter_sums(filters.size());
 
   // group data
   for (GroupID group = 0; group < s.numGroups(); ++group) {
-    const std::string group_name_id = s.groupData(group).name + "-" + s.groupData(group).id.substr(0, 5);
-    const std::string group_path = path + "/" + group_name_id;
     if (s.groupAssignmentList(group).empty()) {
-      removed << s.groupData(group).name << " (" << s.groupData(group).id << ")" << std::endl;
+      removed << s.groupData(group).name << " (" << s.groupData(group).id << ")\n";
     } else {
-      std::ofstream file(group_path);
-      std::vector<size_t> num_per_type(filters.size());
-      for (const auto &pair : s.groupAssignmentList(group)) {
-        const StudentData& data = s.data().students[pair.first];
-        const std::string &rating = s.rating(pair.second)[group].getName();
-        outputStudentDataToFile(data, rating, file);
-        for (size_t i = 0; i < filters.size(); ++i) {
-          if (filters[i].first.apply(data)) {
-            ++num_per_type[i];
-          }
-        }
-      }
-      std::string group_stats = group_name_id + ", " + std::to_string(s.groupSize(group)) + ", ";
+      const GroupReport& report = reports[group];
+      groups_csv << report.content;
+      std::string group_stats = group_name_ids[group] + ", " + std::to_string(s.groupSize(group)) + ", ";
       sum += s.groupSize(group);
       for (size_t i = 0; i < filters.size(); ++i) {
-        group_stats += std::to_string(num_per_type[i]) + (i + 1 == filters.size() ? "" : ", ");
-        filter_sums[i] += num_per_type[i];
+        group_stats += std::to_string(report.num_per_type[i]) + (i + 1 == filters.size() ? "" : ", ");
+        filter_sums[i] += report.num_per_type[i];
       }
-      stats << group_stats << std::endl;
+      stats << group_stats << "\n";
     }
   }
   // Sums
@@ -282,5 +511,5 @@ void writeOutputToFiles(const State &s, std::string path,
   for (size_t i = 0; i < filter_sums.size(); ++i) {
     sums += std::to_string(filter_sums[i]) + (i + 1 == filters.size() ? "" : ", ");
   }
-  stats << sums << std::endl;
+  stats << sums << "\n";
 }
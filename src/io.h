@@ -11,11 +11,28 @@ using PTree = boost::property_tree::ptree;
 
 Input parseInput(const PTree &tree);
 
+// Adds the students, teams and ratings of the tree (same format as the input) to the input.
+// Ratings of existing students are replaced.
+void extendInput(Input &input, const PTree &tree);
+
+// Returns the reason why extendInput would reject the tree (empty if it is valid), so that
+// requests can be rejected without exiting
+std::string checkInputExtension(const Input &input, const PTree &tree);
+
+// removes the students from the input, as well as teams without remaining members
+void removeFromInput(Input &input, const std::vector<std::string> &student_ids);
+
+// group of each student in a previous output (per student or per team), -1 if none
+std::vector<int32_t> parsePreviousAssignment(const Input &input, const PTree &tree);
+
 PTree writeOutputToTree(const State &s);
 
 void writeOutputToFiles(const State &s, std::string path,
     const std::vector<std::pair<Filter, StudentID>> &filters = {});
 
+// appends a line of Groups.csv, fields are quoted as in RFC 4180 if required
+void appendCsvRow(const std::vector<std::string>& fields, std::string& out);
+
 std::string courseTypeToString(CourseType type);
 
 std::string degreeTypeToString(DegreeType type);
@@ -0,0 +1,211 @@
+#include "lap.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "definitions.h"
+#include "thread_pool.h"
+
+// minimum reduced cost of a row, written as plain reduction over the row so the compiler can vectorize it
+int64_t minReducedCost(const int64_t* row_costs, const std::vector<int64_t>& v) {
+  int64_t result = std::numeric_limits<int64_t>::max();
+  for (size_t col = 0; col < v.size(); ++col) {
+    result = std::min(result, row_costs[col] - v[col]);
+  }
+  return result;
+}
+
+std::vector<uint32_t> solveLinearAssignment(const std::vector<int64_t>& costs, size_t num_rows, size_t num_cols) {
+  ASSERT(num_rows <= num_cols && costs.size() == num_rows * num_cols);
+  constexpr int64_t INF = std::numeric_limits<int64_t>::max() / 4;
+  constexpr size_t NONE = std::numeric_limits<size_t>::max();
+
+  // potentials of rows and columns, reduced costs costs[row][col] - u[row] - v[col] stay non-negative.
+  // Columns are only assigned once and the potential of the free columns stays maximal (0)
+  std::vector<int64_t> u(num_rows), v(num_cols, 0);
+  std::vector<size_t> row_of_col(num_cols, NONE);
+  std::vector<size_t> col_of_row(num_rows, NONE);
+  std::vector<size_t> free_rows;
+
+  if (num_rows == num_cols) {
+    // column reduction: each column takes its cheapest row, a row keeps the column with the lowest potential.
+    // Only valid for square matrices, since the potential of columns which stay free is not maximal
+    std::vector<uint32_t> num_matches(num_rows, 0);
+    for (size_t col = num_cols; col-- > 0;) {
+      size_t min_row = 0;
+      for (size_t row = 1; row < num_rows; ++row) {
+        if (costs[row * num_cols + col] < costs[min_row * num_cols + col]) {
+          min_row = row;
+        }
+      }
+      v[col] = costs[min_row * num_cols + col];
+      if (++num_matches[min_row] == 1) {
+        col_of_row[min_row] = col;
+        row_of_col[col] = min_row;
+      } else if (v[col] < v[col_of_row[min_row]]) {
+        row_of_col[col_of_row[min_row]] = NONE;
+        col_of_row[min_row] = col;
+        row_of_col[col] = min_row;
+      }
+    }
+    // reduction transfer: a row with a single column passes its slack to the potential of the column
+    for (size_t row = 0; row < num_rows; ++row) {
+      if (num_matches[row] == 0) {
+        free_rows.push_back(row);
+      } else if (num_matches[row] == 1 && num_cols > 1) {
+        const size_t col = col_of_row[row];
+        const int64_t* row_costs = &costs[row * num_cols];
+        int64_t min_other = INF;
+        for (size_t other = 0; other < num_cols; ++other) {
+          min_other = (other == col) ? min_other : std::min(min_other, row_costs[other] - v[other]);
+        }
+        v[col] -= min_other;
+      }
+    }
+  } else {
+    // row reduction: each row takes its cheapest column if it is still free
+    for (size_t row = 0; row < num_rows; ++row) {
+      const int64_t* row_costs = &costs[row * num_cols];
+      const size_t col = std::min_element(row_costs, row_costs + num_cols) - row_costs;
+      if (row_of_col[col] == NONE) {
+        row_of_col[col] = row;
+        col_of_row[row] = col;
+      } else {
+        free_rows.push_back(row);
+      }
+    }
+  }
+
+  // augmenting row reduction (twice): a free row takes its cheapest column and lowers its potential to the
+  // second cheapest one, the previous row of the column continues. Only lowers potentials of assigned columns
+  for (int pass = 0; pass < 2 && num_cols > 1; ++pass) {
+    std::vector<size_t> next_free_rows;
+    size_t k = 0;
+    while (k < free_rows.size()) {
+      const size_t row = free_rows[k++];
+      const int64_t* row_costs = &costs[row * num_cols];
+      int64_t min_1 = INF, min_2 = INF;
+      size_t col_1 = 0, col_2 = 0;
+      for (size_t col = 0; col < num_cols; ++col) {
+        const int64_t reduced = row_costs[col] - v[col];
+        if (reduced < min_2) {
+          if (reduced < min_1) {
+            min_2 = min_1;
+            col_2 = col_1;
+            min_1 = reduced;
+            col_1 = col;
+          } else {
+            min_2 = reduced;
+            col_2 = col;
+          }
+        }
+      }
+      size_t displaced = row_of_col[col_1];
+      if (min_1 < min_2) {
+        v[col_1] -= min_2 - min_1;
+      } else if (displaced != NONE) {
+        col_1 = col_2;
+        displaced = row_of_col[col_2];
+      }
+      if (displaced != NONE) {
+        col_of_row[displaced] = NONE;
+        if (min_1 < min_2) {
+          free_rows[--k] = displaced;
+        } else {
+          next_free_rows.push_back(displaced);
+        }
+      }
+      row_of_col[col_1] = row;
+      col_of_row[row] = col_1;
+    }
+    free_rows = std::move(next_free_rows);
+    if (cancellationRequested()) {
+      return {};
+    }
+  }
+
+  // potentials of the rows: tight for the assigned column, a lower bound for the free rows
+  for (size_t row = 0; row < num_rows; ++row) {
+    const size_t col = col_of_row[row];
+    u[row] = (col != NONE) ? costs[row * num_cols + col] - v[col] : minReducedCost(&costs[row * num_cols], v);
+  }
+
+  // augmentation: Dijkstra on the reduced costs from each unassigned row to a free column
+  std::vector<int64_t> min_dist(num_cols);
+  std::vector<size_t> predecessor(num_cols);
+  std::vector<bool> scanned(num_cols);
+  std::vector<size_t> scanned_cols;
+  for (size_t start_row = 0; start_row < num_rows; ++start_row) {
+    if (col_of_row[start_row] != NONE) {
+      continue;
+    }
+    if (cancellationRequested()) {
+      return {};
+    }
+    std::fill(min_dist.begin(), min_dist.end(), INF);
+    std::fill(scanned.begin(), scanned.end(), false);
+    scanned_cols.clear();
+
+    size_t row = start_row;
+    int64_t dist_to_row = 0;
+    size_t last_col = NONE;
+    size_t free_col = NONE;
+    while (free_col == NONE) {
+      const int64_t* row_costs = &costs[row * num_cols];
+      const int64_t offset = dist_to_row - u[row];
+      int64_t best = INF;
+      size_t best_col = NONE;
+      for (size_t col = 0; col < num_cols; ++col) {
+        if (scanned[col]) {
+          continue;
+        }
+        const int64_t dist = offset + row_costs[col] - v[col];
+        if (dist < min_dist[col]) {
+          min_dist[col] = dist;
+          predecessor[col] = last_col;
+        }
+        if (min_dist[col] < best) {
+          best = min_dist[col];
+          best_col = col;
+        }
+      }
+      ASSERT(best_col != NONE);
+      scanned[best_col] = true;
+      scanned_cols.push_back(best_col);
+      last_col = best_col;
+      dist_to_row = best;
+      if (row_of_col[best_col] == NONE) {
+        free_col = best_col;
+      } else {
+        row = row_of_col[best_col];
+      }
+    }
+
+    // update the potentials of the scanned columns and their rows, then flip the path
+    const int64_t total_dist = min_dist[free_col];
+    u[start_row] += total_dist;
+    for (size_t col : scanned_cols) {
+      if (col != free_col) {
+        const int64_t delta = total_dist - min_dist[col];
+        v[col] -= delta;
+        u[row_of_col[col]] += delta;
+      }
+    }
+    size_t col = free_col;
+    while (col != NONE) {
+      const size_t prev_col = predecessor[col];
+      const size_t new_row = (prev_col == NONE) ? start_row : row_of_col[prev_col];
+      row_of_col[col] = new_row;
+      col_of_row[new_row] = col;
+      col = prev_col;
+    }
+  }
+
+  std::vector<uint32_t> result(num_rows);
+  for (size_t row = 0; row < num_rows; ++row) {
+    result[row] = col_of_row[row];
+  }
+  return result;
+}
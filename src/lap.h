@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ####################################
+// ######  Linear Assignment (JV)  ######
+// ####################################
+
+// Solves the rectangular linear assignment problem for a row-major cost matrix with
+// num_rows <= num_cols, i.e. assigns each row to a distinct column with minimum total cost.
+// Uses shortest augmenting paths with dual potentials as in Jonker-Volgenant, initialized by a column
+// reduction with reduction transfer (square matrices) or a row reduction, followed by the augmenting row
+// reduction. Returns the column of each row, or an empty vector if cancellation is requested.
+std::vector<uint32_t> solveLinearAssignment(const std::vector<int64_t>& costs, size_t num_rows, size_t num_cols);
@@ -3,30 +3,43 @@
 #include <chrono>
 #include <ios>
 #include <csignal>
+#include <optional>
 #include <random>
+#include <sstream>
 
 #include "boost/property_tree/json_parser.hpp"
 #include "boost/program_options.hpp"
 
 #include "algorithms.h"
+#include "exact.h"
 #include "io.h"
 #include "config.h"
+#include "server.h"
 #include "student_types.h"
+#include "sweep.h"
+#include "thread_pool.h"
 
 namespace po = boost::program_options;
 
+// the summary tables are written directly to stdout (independent of the verbosity) after the pending log lines
+void printTableLine(const std::string& line) {
+  flushLog();
+  std::cout << line << std::endl;
+}
+
 template<typename T, typename F>
 void printTabularLine(const std::vector<T>& data, const std::string& head, F f, int first_size = 7) {
   // note: does not work correctly with unicode...
-  std::cout << std::left << TRACE_START << std::setw(first_size) << head;
+  std::ostringstream line;
+  line << std::left << TRACE_START << std::setw(first_size) << head;
   for (const auto& val: data) {
     std::string word = f(val);
     const int width = std::max<int>(15, word.size());
     int left = (width - word.size()) / 2 + word.size();
     int right = (width - word.size() + 1) / 2;
-    std::cout << std::right << " " << std::setw(left) << f(val) << std::setw(right) << "";
+    line << std::right << " " << std::setw(left) << f(val) << std::setw(right) << "";
   }
-  std::cout << std::endl;
+  printTableLine(line.str());
 }
 
 // print number of ratings for different rating levels
@@ -99,6 +112,29 @@ void printGroupSizes(const State& state) {
   }
 }
 
+// print expected demand of each group, ascending
+void printGroupDemand(const State& state) {
+  const std::vector<double> demand = computeGroupDemand(state);
+  std::vector<GroupID> order;
+  for (GroupID group = 0; group < state.numGroups(); ++group) {
+    if (state.groupIsEnabled(group)) {
+      order.push_back(group);
+    }
+  }
+  std::sort(order.begin(), order.end(), [&](GroupID g1, GroupID g2) {
+    return demand[g1] < demand[g2];
+  });
+  printTabularLine(std::vector{"demand", "min size", "capacity"}, "Group", [](const auto& val) { return val; }, 30);
+  for (GroupID group : order) {
+    std::ostringstream formatted_demand;
+    formatted_demand << std::fixed << std::setprecision(1) << demand[group];
+    printTabularLine(std::vector{
+        formatted_demand.str(), std::to_string(state.groupData(group).min_target_size),
+        std::to_string(state.groupData(group).capacity)
+      }, state.groupData(group).name, [](const auto& val) { return val; }, 30);
+  }
+}
+
 void printStudentsPerGroup(const State& state) {
   LOG(TRACE_START, 1);
   for (GroupID group = 0; group < state.numGroups(); ++group) {
@@ -138,22 +174,45 @@ void printGroupSizes(const State& state, const std::vector<std::pair<Filter, Stu
   LOG(TRACE_START << "# Group Sizes #  type_specific[total]", 1);
   for (const auto& [filter, _]: filters) {
     auto group_sizes = groupSizesForType(state, filter);
-    std::cout << std::left << TRACE_START << std::setw(17) << filter.name;
+    std::ostringstream line;
+    line << std::left << TRACE_START << std::setw(17) << filter.name;
     for (size_t i = 0; i < group_sizes.size(); ++i) {
       auto [ts, total] = group_sizes[i];
       if (i > 0) {
-        std::cout << ", ";
+        line << ", ";
       }
-      std::cout << ts << "[" << total << "]";
+      line << ts << "[" << total << "]";
     }
-    std::cout << std::endl;
+    printTableLine(line.str());
+  }
+}
+
+PTree readJsonFile(const std::string& filename) {
+  std::ifstream file(filename);
+  if (!file) {
+    FATAL_ERROR("Error opening file: " << filename);
+  }
+  PTree result;
+  boost::property_tree::json_parser::read_json(file, result);
+  return result;
+}
+
+// invalid option values are reported by the notifiers via exceptions
+void notifyOptions(po::variables_map& vm) {
+  try {
+    po::notify(vm);
+  } catch (const po::error& e) {
+    FATAL_ERROR(e.what());
   }
 }
 
 // parse command line arguments and (if provided) config file,
 // using the boost program options library
 void parseCmdAndConfig(int argc, const char *argv[], std::string& in_filename,
-                       std::string& out_filename, std::string& groups_filename, std::string& types_filename) {
+                       std::string& out_filename, std::string& groups_filename, std::string& types_filename,
+                       std::string& model_filename, std::string& socket_path,
+                       std::string& previous_filename, std::string& delta_filename,
+                       std::string& sweep_filename) {
   po::options_description config_options = Config::getConfigOptions();
 
   std::string config;
@@ -164,8 +223,8 @@ void parseCmdAndConfig(int argc, const char *argv[], std::string& in_filename,
             po::value<std::string>(&in_filename)->value_name("<string>")->required(),
             "Input filename (required)")
           ("output,o",
-            po::value<std::string>(&out_filename)->value_name("<string>")->required(),
-            "Output filename (required)")
+            po::value<std::string>(&out_filename)->value_name("<string>"),
+            "Output filename (required, unless --serve is used)")
           ("config,c",
             po::value<std::string>(&config)->value_name("<string>"),
             "Config filename")
@@ -175,7 +234,26 @@ void parseCmdAndConfig(int argc, const char *argv[], std::string& in_filename,
           ("groups,g",
             po::value<std::string>(&groups_filename)->value_name("<string>"),
             "Groups directory: If present, creates for each group a file "
-            "with all assigned students of the group in the specified directory");
+            "with all assigned students of the group in the specified directory")
+          ("export-model",
+            po::value<std::string>(&model_filename)->value_name("<string>"),
+            "Writes the exact model of the assignment problem to the specified file "
+            "(MPS format if the filename ends with .mps, otherwise LP format)")
+          ("previous-output",
+            po::value<std::string>(&previous_filename)->value_name("<string>"),
+            "Output of a previous run: Participants keep their previous group if possible (see --move-penalty)")
+          ("input-delta",
+            po::value<std::string>(&delta_filename)->value_name("<string>"),
+            "Changes applied to the input: additional students, teams and ratings (in input format) "
+            "and a list of student ids under \"withdrawn\"")
+          ("serve",
+            po::value<std::string>(&socket_path)->value_name("<string>"),
+            "Instead of writing an output file, keeps the input in memory and answers requests "
+            "(edits and re-solves) on the Unix socket with the specified path")
+          ("sweep",
+            po::value<std::string>(&sweep_filename)->value_name("<string>"),
+            "Sweep file with one option per line (`name = value, value, ...`): Runs the assignment for each "
+            "combination of the values concurrently and writes a comparison table (CSV) to the output file");
   cmd_options.add(config_options);
 
   po::variables_map cmd_vm;
@@ -185,7 +263,7 @@ void parseCmdAndConfig(int argc, const char *argv[], std::string& in_filename,
     std::cout << cmd_options << std::endl;
     exit(0);
   }
-  po::notify(cmd_vm);
+  notifyOptions(cmd_vm);
 
   if ( config != "" ) {
     std::ifstream config_file(config.c_str());
@@ -194,7 +272,10 @@ void parseCmdAndConfig(int argc, const char *argv[], std::string& in_filename,
     }
 
     po::store(po::parse_config_file(config_file, config_options, true), cmd_vm);
-    po::notify(cmd_vm);
+    notifyOptions(cmd_vm);
+  }
+  if (out_filename == "" && socket_path == "") {
+    FATAL_ERROR("the option '--output' is required but missing");
   }
   Config::check();
 }
@@ -202,17 +283,22 @@ void parseCmdAndConfig(int argc, const char *argv[], std::string& in_filename,
 int main(int argc, const char *argv[]) {
   std::chrono::time_point<std::chrono::system_clock> timer_start = std::chrono::system_clock::now();
 
-  std::string in_filename, out_filename, groups_filename, types_filename;
-  parseCmdAndConfig(argc, argv, in_filename, out_filename, groups_filename, types_filename);
+  std::string in_filename, out_filename, groups_filename, types_filename, model_filename, socket_path;
+  std::string previous_filename, delta_filename, sweep_filename;
+  parseCmdAndConfig(argc, argv, in_filename, out_filename, groups_filename, types_filename, model_filename,
+                    socket_path, previous_filename, delta_filename, sweep_filename);
   TRACE("Reading arguments and config completed.", true);
 
   std::ifstream in_file(in_filename);
   if (!in_file) {
     FATAL_ERROR("Error opening input file");
   }
-  std::ofstream out_file(out_filename);
-  if (!out_file) {
-    FATAL_ERROR("Error opening output file");
+  std::ofstream out_file;
+  if (socket_path == "") {
+    out_file.open(out_filename);
+    if (!out_file) {
+      FATAL_ERROR("Error opening output file");
+    }
   }
 
   std::vector<std::pair<Filter, StudentID>> type_filters;
@@ -231,6 +317,26 @@ int main(int argc, const char *argv[]) {
   Input input = parseInput(pt);
   PROGRESS("Input file successfully parsed.", true);
 
+  if (delta_filename != "") {
+    PTree delta = readJsonFile(delta_filename);
+    std::vector<std::string> withdrawn;
+    if (delta.find("withdrawn") != delta.not_found()) {
+      for (const auto& element : delta.find("withdrawn")->second) {
+        withdrawn.push_back(element.second.get_value<std::string>());
+      }
+    }
+    const size_t num_students = input.students.size();
+    removeFromInput(input, withdrawn);
+    const size_t num_remaining = input.students.size();
+    extendInput(input, delta);
+    INFO("Input delta applied: " << (num_students - num_remaining) << " students withdrawn, "
+         << (input.students.size() - num_remaining) << " students added.", true);
+  }
+  std::vector<int32_t> previous_group;
+  if (previous_filename != "") {
+    previous_group = parsePreviousAssignment(input, readJsonFile(previous_filename));
+  }
+
   StudentID n_disabled = 0;
   for (const StudentData& s: input.students){
     if (!s.type_specific_assignment) {
@@ -243,20 +349,85 @@ int main(int argc, const char *argv[]) {
   // register signal handler
   signal(SIGINT, signalHandler);
 
+  if (socket_path != "") {
+    runServer(socket_path, std::move(input), type_filters);
+    return 0;
+  }
+  if (sweep_filename != "") {
+    std::ifstream sweep_file(sweep_filename);
+    if (!sweep_file) {
+      FATAL_ERROR("Error opening sweep file");
+    }
+    runSweep(input, type_filters, parseSweepFile(sweep_file), out_file);
+    INFO("Sweep written to: " << out_filename, true);
+    return 0;
+  }
+
+  std::optional<DeadlineScope> deadline_scope;
+  if (Config::get().time_limit > 0) {
+    // the time limit includes reading the input
+    const std::chrono::duration<double> elapsed = std::chrono::system_clock::now() - timer_start;
+    deadline_scope.emplace(deadlineAfter(Config::get().time_limit - elapsed.count()));
+  }
+
   std::mt19937_64 random_gen(Config::get().random_seed);
   State state(input, random_gen);
   if (Config::get().use_min_group_sizes) {
     printGroupSizes(state);
   }
+  if (Config::get().verbosity_level >= 2) {
+    printGroupDemand(state);
+  }
 
-  assignWithMinimumNumberPerGroup(state, Config::get().group_disable_threshold);
+  if (!previous_group.empty()) {
+    state.setPreviousAssignment(previous_group, Config::get().move_penalty);
+  }
+  if (!previous_group.empty() && Config::get().move_penalty == 0) {
+    const ParticipantID num_kept = keepPreviousAssignment(state);
+    INFO("Kept the previous group for " << num_kept << " of " << state.numParticipants() << " participants.", true);
+    if (!assignRemainingParticipants(state, true)) {
+      std::exit(-1);
+    }
+  } else {
+    if (!assignWithMinimumNumberPerGroup(state, Config::get().group_disable_threshold)) {
+      std::exit(-1);
+    }
 
-  if (Config::get().verbosity_level >= 3) {
-    printNumberPerRating(state, type_filters);
-    printStudentsPerGroup(state);
+    if (Config::get().verbosity_level >= 3) {
+      printNumberPerRating(state, type_filters);
+      printStudentsPerGroup(state);
+    }
+
+    assertTypeMinima(state, type_filters);
   }
 
-  assertMinimumNumberPerGroupForSpecificType(state, type_filters);
+  if (model_filename != "") {
+    std::ofstream model_file(model_filename);
+    if (!model_file) {
+      FATAL_ERROR("Error opening model file");
+    }
+    LinearModel model = buildLinearModel(state, type_filters);
+    const std::string mps_suffix = ".mps";
+    if (model_filename.size() >= mps_suffix.size()
+        && model_filename.compare(model_filename.size() - mps_suffix.size(), mps_suffix.size(), mps_suffix) == 0) {
+      writeMPS(model, model_file);
+    } else {
+      writeLP(model, model_file);
+    }
+    INFO("Model with " << model.variables.size() << " variables and " << model.constraints.size()
+         << " constraints written to: " << model_filename, true);
+  }
+
+  if (Config::get().exact_solve) {
+    applyExactSolution(state, type_filters);
+  }
+
+  // the state always contains a complete assignment, i.e. the best one found so far is written
+  if (cancellationRequested()) {
+    WARNING("Calculation stopped due to time limit or interrupt. Writing the best assignment found so far.", true);
+  }
+  deadline_scope.reset();
+  resetCancellation();
 
   if (Config::get().verbosity_level >= 1) {
     printNumberPerRating(state, type_filters);
@@ -0,0 +1,260 @@
+#include "server.h"
+
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "boost/property_tree/json_parser.hpp"
+
+#include "algorithms.h"
+#include "config.h"
+#include "io.h"
+#include "thread_pool.h"
+
+// ####################################
+// ########   Socket Helpers   ########
+// ####################################
+
+// reads the next line from the client, returns false on EOF, error or interruption
+bool readLine(int fd, std::string& buffer, std::string& line) {
+  while (true) {
+    const size_t end = buffer.find('\n');
+    if (end != std::string::npos) {
+      line = buffer.substr(0, end);
+      buffer.erase(0, end + 1);
+      return true;
+    }
+    pollfd pfd{fd, POLLIN, 0};
+    const int ready = poll(&pfd, 1, 100);
+    if (cancellationRequested()) {
+      return false;
+    } else if (ready <= 0) {
+      continue;
+    }
+    char chunk[4096];
+    const ssize_t num_read = recv(fd, chunk, sizeof(chunk), 0);
+    if (num_read <= 0) {
+      return false;
+    }
+    buffer.append(chunk, num_read);
+  }
+}
+
+bool writeAll(int fd, const std::string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    const ssize_t num = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+    if (num <= 0) {
+      return false;
+    }
+    written += num;
+  }
+  return true;
+}
+
+// ####################################
+// ########  Assignment Server  ########
+// ####################################
+
+AssignmentServer::AssignmentServer(Input input, const std::vector<std::pair<Filter, StudentID>>& type_filters):
+    _input(std::move(input)), _type_filters(type_filters), _disabled(_input.groups.size(), false),
+    _random_gen(Config::get().random_seed) {
+  for (GroupID group = 0; group < _input.groups.size(); ++group) {
+    _group_id_to_index[_input.groups[group].id] = group;
+  }
+}
+
+bool AssignmentServer::handle(const PTree& request, PTree& response) {
+  const std::string command = request.get<std::string>("command");
+  INFO("Request: " << command, true);
+  response.put("status", "ok");
+  if (command == "solve") {
+    solve(request.get<bool>("warm_start", true), response);
+  } else if (command == "set_capacity") {
+    const GroupID group = groupIndex(request, response);
+    // read as signed value, so that negative capacities are not wrapped around
+    const int64_t capacity = request.get<int64_t>("capacity");
+    std::vector<int32_t> slot_bonus;
+    if (group >= _input.groups.size()) {
+      // unknown group, already reported
+    } else if (capacity < 0 || capacity > std::numeric_limits<StudentID>::max()) {
+      error(response, "Invalid capacity: " + std::to_string(capacity));
+    } else if (capacity < _input.groups[group].min_target_size) {
+      error(response, "Capacity must not be smaller than the minimum size");
+    } else if (!State::computeSlotBonus(capacity, _input.groups[group].min_target_size, slot_bonus)) {
+      error(response, "Min group size must be significantly below capacity");
+    } else {
+      _input.groups[group].capacity = capacity;
+    }
+  } else if (command == "disable_group" || command == "enable_group") {
+    const GroupID group = groupIndex(request, response);
+    if (group < _input.groups.size()) {
+      _disabled[group] = (command == "disable_group");
+    }
+  } else if (command == "add_participants") {
+    addParticipants(request, response);
+  } else if (command == "result") {
+    response.add_child("output", _last_output);
+  } else if (command == "shutdown") {
+    return false;
+  } else {
+    error(response, "Unknown command: " + command);
+  }
+  return true;
+}
+
+void AssignmentServer::error(PTree& response, const std::string& message) {
+  WARNING(message, true);
+  response.put("status", "error");
+  response.put("message", message);
+}
+
+GroupID AssignmentServer::groupIndex(const PTree& request, PTree& response) {
+  const std::string id = request.get<std::string>("group");
+  auto it = _group_id_to_index.find(id);
+  if (it == _group_id_to_index.end()) {
+    error(response, "Unknown group: " + id);
+    return _input.groups.size();
+  }
+  return it->second;
+}
+
+void AssignmentServer::addParticipants(const PTree& request, PTree& response) {
+  std::string message = checkInputExtension(_input, request);
+  if (message.empty()) {
+    // e.g. conflicting team ratings are only detected on the extended input
+    Input extended(_input);
+    extendInput(extended, request);
+    message = State::checkInput(extended);
+  }
+  if (!message.empty()) {
+    error(response, message);
+    return;
+  }
+  const size_t num_students = _input.students.size();
+  extendInput(_input, request);
+  response.put("added_students", _input.students.size() - num_students);
+}
+
+void AssignmentServer::solve(bool warm_start, PTree& response) {
+  std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+  // the time limit applies to each request
+  std::optional<DeadlineScope> deadline_scope;
+  if (Config::get().time_limit > 0) {
+    deadline_scope.emplace(deadlineAfter(Config::get().time_limit));
+  }
+  const std::string message = State::checkInput(_input);
+  if (!message.empty()) {
+    error(response, message);
+    return;
+  }
+  State state(_input, _random_gen);
+  for (GroupID group = 0; group < state.numGroups(); ++group) {
+    if (_disabled[group]) {
+      state.disableGroup(group);
+    }
+  }
+  if (state.totalActiveGroupCapacity() <= state.numStudents()) {
+    error(response, "Not enough capacity available");
+    return;
+  }
+
+  bool success;
+  ParticipantID num_kept = 0;
+  if (warm_start && !_previous.empty()) {
+    // only the participants without valid previous group are assigned, type minima are not reasserted
+    std::vector<int32_t> previous_group(_input.students.size(), -1);
+    for (StudentID student = 0; student < _input.students.size(); ++student) {
+      auto it = _previous.find(_input.students[student].id);
+      if (it != _previous.end()) {
+        previous_group[student] = it->second;
+      }
+    }
+    state.setPreviousAssignment(previous_group, 0);
+    num_kept = keepPreviousAssignment(state);
+    success = assignRemainingParticipants(state, true);
+  } else {
+    success = assignWithMinimumNumberPerGroup(state, Config::get().group_disable_threshold);
+    if (success) {
+      assertTypeMinima(state, _type_filters);
+    }
+  }
+  if (!success) {
+    error(response, "Could not calculate an assignment");
+    return;
+  }
+
+  _previous.clear();
+  for (GroupID group = 0; group < state.numGroups(); ++group) {
+    for (const auto& [student, _] : state.groupAssignmentList(group)) {
+      _previous[_input.students[student].id] = group;
+    }
+  }
+  _last_output = writeOutputToTree(state);
+  size_t num_violations = 0;
+  for (const auto& violations : typeMinimumViolations(state, _type_filters)) {
+    num_violations += violations.size();
+  }
+  response.put("participants", state.numParticipants());
+  response.put("kept", num_kept);
+  response.put("total_weight", totalWeight(state));
+  response.put("time_limit_reached", deadlineReached());
+  response.put("type_minimum_violations", num_violations);
+  response.put("time_ms", std::chrono::duration<double, std::milli>(std::chrono::system_clock::now() - start).count());
+}
+
+void runServer(const std::string& socket_path, Input input,
+               const std::vector<std::pair<Filter, StudentID>>& type_filters) {
+  AssignmentServer server(std::move(input), type_filters);
+
+  const int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  ASSERT_WITH(socket_path.size() < sizeof(address.sun_path), "Socket path too long: " << socket_path);
+  std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+  unlink(socket_path.c_str());
+  if (server_fd < 0 || bind(server_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+      || listen(server_fd, 4) != 0) {
+    FATAL_ERROR("Could not listen on socket: " << socket_path);
+  }
+  INFO("Listening on " << socket_path, true);
+
+  bool running = true;
+  while (running && !cancellationRequested()) {
+    pollfd pfd{server_fd, POLLIN, 0};
+    if (poll(&pfd, 1, 100) <= 0) {
+      continue;
+    }
+    const int client_fd = accept(server_fd, nullptr, nullptr);
+    if (client_fd < 0) {
+      continue;
+    }
+    std::string buffer, line;
+    while (running && readLine(client_fd, buffer, line)) {
+      PTree request, response;
+      try {
+        std::istringstream in(line);
+        boost::property_tree::json_parser::read_json(in, request);
+        running = server.handle(request, response);
+      } catch (const boost::property_tree::ptree_error& e) {
+        response.put("status", "error");
+        response.put("message", e.what());
+      }
+      std::ostringstream out;
+      boost::property_tree::json_parser::write_json(out, response, false);
+      if (!writeAll(client_fd, out.str())) {
+        break;
+      }
+    }
+    close(client_fd);
+  }
+  close(server_fd);
+  unlink(socket_path.c_str());
+  INFO("Server stopped.", true);
+}
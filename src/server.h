@@ -0,0 +1,52 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "definitions.h"
+#include "io.h"
+
+// ####################################
+// ########    Server Mode     ########
+// ####################################
+
+// Keeps the input and the last solution in memory and answers requests on a Unix socket until
+// SIGINT or a shutdown request. Each request and response is a single line of JSON:
+//  - {"command": "solve", "warm_start": true}: re-solves, keeping previous assignments if possible
+//  - {"command": "set_capacity", "group": <id>, "capacity": <int>}
+//  - {"command": "disable_group", "group": <id>} and {"command": "enable_group", "group": <id>}
+//  - {"command": "add_participants", "students": ..., "teams": ..., "ratings": ...} (input format)
+//  - {"command": "result"}: the last solution in output format
+//  - {"command": "shutdown"}
+// Handles the requests independent of the socket. Invalid requests are answered with
+// {"status": "error", "message": ...} and leave the state of the server unchanged.
+class AssignmentServer {
+  Input _input;
+  const std::vector<std::pair<Filter, StudentID>>& _type_filters;
+  std::unordered_map<std::string, GroupID> _group_id_to_index;
+  std::vector<bool> _disabled;
+  // group of each student in the last solution
+  std::unordered_map<std::string, GroupID> _previous;
+  PTree _last_output;
+  std::mt19937_64 _random_gen;
+
+ public:
+  AssignmentServer(Input input, const std::vector<std::pair<Filter, StudentID>>& type_filters);
+
+  // returns false if the server should stop
+  bool handle(const PTree& request, PTree& response);
+
+ private:
+  void error(PTree& response, const std::string& message);
+
+  GroupID groupIndex(const PTree& request, PTree& response);
+
+  void addParticipants(const PTree& request, PTree& response);
+
+  void solve(bool warm_start, PTree& response);
+};
+
+void runServer(const std::string& socket_path, Input input,
+               const std::vector<std::pair<Filter, StudentID>>& type_filters);
@@ -33,7 +33,7 @@ std::unordered_map<std::string, std::tuple<FilterFn, uint32_t, std::string>> ini
   return mapping;
 }
 
-std::vector<std::pair<Filter, StudentID>> parseTypesFile(std::ifstream& file) {
+std::vector<std::pair<Filter, StudentID>> parseTypesFile(std::istream& file) {
   auto mapping = initializeTypeToFilterMapping();
 
   std::vector<std::pair<Filter, StudentID>> result;
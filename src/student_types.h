@@ -8,4 +8,4 @@
 
 #include "definitions.h"
 
-std::vector<std::pair<Filter, StudentID>> parseTypesFile(std::ifstream& file);
+std::vector<std::pair<Filter, StudentID>> parseTypesFile(std::istream& file);
@@ -0,0 +1,155 @@
+#include "sweep.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+
+#include "config.h"
+#include "group_assignment.h"
+#include "io.h"
+#include "thread_pool.h"
+
+std::string trim(const std::string& str) {
+  const size_t begin = str.find_first_not_of(" \t\r");
+  if (begin == std::string::npos) {
+    return "";
+  }
+  return str.substr(begin, str.find_last_not_of(" \t\r") - begin + 1);
+}
+
+SweepGrid parseSweepFile(std::istream& in) {
+  SweepGrid grid;
+  std::string line;
+  while (std::getline(in, line)) {
+    line = trim(line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    const size_t separator = line.find('=');
+    ASSERT_WITH(separator != std::string::npos, "Invalid line in sweep file: " << line);
+    std::vector<std::string> values;
+    std::istringstream value_list(line.substr(separator + 1));
+    std::string value;
+    while (std::getline(value_list, value, ',')) {
+      value = trim(value);
+      if (!value.empty()) {
+        values.push_back(value);
+      }
+    }
+    ASSERT_WITH(!values.empty(), "No values in sweep file for: " << line);
+    grid.emplace_back(trim(line.substr(0, separator)), std::move(values));
+  }
+  return grid;
+}
+
+std::vector<std::vector<std::pair<std::string, std::string>>> expandSweepGrid(const SweepGrid& grid) {
+  // the first option varies slowest
+  std::vector<std::vector<std::pair<std::string, std::string>>> combinations(1);
+  for (const auto& [name, values] : grid) {
+    std::vector<std::vector<std::pair<std::string, std::string>>> extended;
+    for (const auto& combination : combinations) {
+      for (const std::string& value : values) {
+        extended.push_back(combination);
+        extended.back().emplace_back(name, value);
+      }
+    }
+    combinations = std::move(extended);
+  }
+  return combinations;
+}
+
+struct SweepRun {
+  std::vector<std::pair<std::string, std::string>> values;
+  Config options;
+  AssignmentResult result;
+  double runtime = 0;
+};
+
+void runSweep(const Input& input, const std::vector<std::pair<Filter, StudentID>>& type_filters,
+              const SweepGrid& grid, std::ostream& out) {
+  std::vector<SweepRun> runs;
+  for (auto& values : expandSweepGrid(grid)) {
+    SweepRun& run = runs.emplace_back();
+    run.values = std::move(values);
+    // an invalid combination is reported in its row instead of stopping the sweep
+    std::optional<Config> options = Config::withOverrides(run.values, run.result.message);
+    if (options) {
+      run.options = *options;
+      run.options.verbosity_level = 0;
+    }
+  }
+  INFO("Running " << runs.size() << " configurations.", true);
+
+  TaskGroup tasks;
+  // the configurations running at the same time share the memory limit
+  const size_t num_concurrent = std::max<size_t>(1, std::min(runs.size(), ThreadPool::get().numThreads()));
+  for (SweepRun& run : runs) {
+    if (run.options.memory_limit > 0) {
+      run.options.memory_limit = std::max<size_t>(1, run.options.memory_limit / num_concurrent);
+    }
+  }
+  for (size_t i = 0; i < runs.size(); ++i) {
+    tasks.run([&, i] {
+      SweepRun& run = runs[i];
+      if (!run.result.message.empty()) {
+        return;
+      }
+      std::chrono::time_point<std::chrono::system_clock> start = std::chrono::system_clock::now();
+      run.result = runAssignment(input, type_filters, run.options);
+      run.runtime = std::chrono::duration<double>(std::chrono::system_clock::now() - start).count();
+      PROGRESS("Configuration " << (i + 1) << " of " << runs.size() << " finished.", true);
+    });
+  }
+  if (!tasks.wait()) {
+    ERROR("SIGINT received. Interrupting...", true);
+    return;
+  }
+
+  // CSV for further processing, aligned columns for the log
+  std::vector<std::string> header;
+  for (const auto& [name, _] : grid) {
+    header.push_back(name);
+  }
+  for (const char* column : {"success", "total_weight", "average_rating", "active_groups",
+                             "type_minimum_violations", "runtime_s", "message"}) {
+    header.push_back(column);
+  }
+  std::vector<std::vector<std::string>> rows{header};
+  for (const SweepRun& run : runs) {
+    std::vector<std::string> row;
+    for (const auto& [_, value] : run.values) {
+      row.push_back(value);
+    }
+    std::ostringstream average_rating, runtime;
+    average_rating << std::fixed << std::setprecision(3) << run.result.average_rating;
+    runtime << std::fixed << std::setprecision(3) << run.runtime;
+    row.push_back(run.result.success ? "yes" : "no");
+    row.push_back(run.result.success ? std::to_string(run.result.total_weight) : "");
+    row.push_back(run.result.success ? average_rating.str() : "");
+    row.push_back(run.result.success ? std::to_string(run.result.num_active_groups) : "");
+    row.push_back(run.result.success ? std::to_string(run.result.num_type_minimum_violations) : "");
+    row.push_back(runtime.str());
+    row.push_back(run.result.message);
+    rows.push_back(std::move(row));
+  }
+  std::vector<size_t> widths(header.size(), 0);
+  for (const auto& row : rows) {
+    for (size_t i = 0; i < row.size(); ++i) {
+      widths[i] = std::max(widths[i], row[i].size());
+    }
+  }
+  for (const auto& row : rows) {
+    std::string csv_row;
+    appendCsvRow(row, csv_row);
+    out << csv_row;
+    std::ostringstream line;
+    line << TRACE_START;
+    for (size_t i = 0; i < row.size(); ++i) {
+      line << std::left << std::setw(widths[i] + 2) << row[i];
+    }
+    LOG(line.str(), 1);
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "definitions.h"
+
+// ####################################
+// ########  Parameter Sweep   ########
+// ####################################
+
+// each option with the values to try
+using SweepGrid = std::vector<std::pair<std::string, std::vector<std::string>>>;
+
+// One option per line in the format `name = value, value, ...` with the names of the config file.
+// Empty lines and lines starting with # are ignored.
+SweepGrid parseSweepFile(std::istream& in);
+
+// all combinations of the option values (name and value), the first option varies slowest
+std::vector<std::vector<std::pair<std::string, std::string>>> expandSweepGrid(const SweepGrid& grid);
+
+// Runs the assignment for every combination of the option values (based on the global options)
+// concurrently, each on its own copy of the input, and writes a comparison table of runtime and
+// quality to `out` (CSV) and to the log. Invalid combinations (e.g. unknown values) are reported as
+// failed rows with the reason, the other combinations are still calculated.
+void runSweep(const Input& input, const std::vector<std::pair<Filter, StudentID>>& type_filters,
+              const SweepGrid& grid, std::ostream& out);
@@ -0,0 +1,206 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+#include "config.h"
+
+static std::atomic_bool cancellation_requested(false);
+static thread_local std::optional<std::chrono::steady_clock::time_point> current_deadline;
+
+// pool and queue of the current thread, if it is a worker
+static thread_local ThreadPool* current_pool = nullptr;
+static thread_local size_t current_queue = 0;
+
+void requestCancellation() {
+  cancellation_requested.store(true);
+}
+
+bool interruptRequested() {
+  return cancellation_requested.load();
+}
+
+bool deadlineReached() {
+  return current_deadline && std::chrono::steady_clock::now() >= *current_deadline;
+}
+
+bool cancellationRequested() {
+  return interruptRequested() || deadlineReached();
+}
+
+void resetCancellation() {
+  cancellation_requested.store(false);
+}
+
+std::chrono::steady_clock::time_point deadlineAfter(double seconds) {
+  return std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(seconds));
+}
+
+DeadlineScope::DeadlineScope(std::optional<std::chrono::steady_clock::time_point> deadline):
+    _previous(current_deadline) {
+  current_deadline = deadline;
+}
+
+DeadlineScope::~DeadlineScope() {
+  current_deadline = _previous;
+}
+
+std::optional<std::chrono::steady_clock::time_point> DeadlineScope::active() {
+  return current_deadline;
+}
+
+// ####################################
+// ########    Thread Pool     ########
+// ####################################
+
+ThreadPool::ThreadPool(size_t num_threads): _num_queued(0), _next_queue(0), _stop(false) {
+  ASSERT(num_threads > 0);
+  for (size_t i = 0; i < num_threads; ++i) {
+    _queues.push_back(std::make_unique<Queue>());
+  }
+  for (size_t i = 0; i < num_threads; ++i) {
+    _threads.emplace_back([this, i] { workerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(_sleep_mutex);
+    _stop = true;
+  }
+  _wakeup.notify_all();
+  for (std::thread& thread : _threads) {
+    thread.join();
+  }
+}
+
+ThreadPool& ThreadPool::get() {
+  size_t num_threads = Config::get().threads;
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // one pool per thread count, so that concurrent library calls use their own --threads option.
+  // The pools are never destroyed, so that abandoned tasks (e.g. after SIGINT) don't block the exit
+  static std::mutex pools_mutex;
+  static std::map<size_t, ThreadPool*> pools;
+  std::lock_guard<std::mutex> lock(pools_mutex);
+  ThreadPool*& pool = pools[num_threads];
+  if (pool == nullptr) {
+    pool = new ThreadPool(num_threads);
+  }
+  return *pool;
+}
+
+size_t ThreadPool::numThreads() const {
+  return _threads.size();
+}
+
+void ThreadPool::submit(Task task) {
+  task = [config = Config::activeInstance(), sink = LogScope::active(), deadline = DeadlineScope::active(),
+          task = std::move(task)] {
+    Config::Scope config_scope(config);
+    LogScope log_scope(sink);
+    DeadlineScope deadline_scope(deadline);
+    task();
+  };
+  const size_t index = (current_pool == this) ? current_queue
+                       : _next_queue.fetch_add(1) % _queues.size();
+  {
+    std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+    _queues[index]->tasks.push_back(std::move(task));
+  }
+  {
+    // the lock prevents a lost wakeup between checking the counter and sleeping
+    std::lock_guard<std::mutex> lock(_sleep_mutex);
+    _num_queued.fetch_add(1);
+  }
+  _wakeup.notify_one();
+}
+
+void ThreadPool::helpWhile(const std::function<bool()>& pending) {
+  while (pending()) {
+    std::optional<Task> task;
+    if (current_pool == this) {
+      task = popTask(current_queue);
+    }
+    if (task) {
+      (*task)();
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+std::optional<ThreadPool::Task> ThreadPool::popTask(size_t own_index) {
+  for (size_t i = 0; i < _queues.size(); ++i) {
+    Queue& queue = *_queues[(own_index + i) % _queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      Task task;
+      if (i == 0) {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+      } else {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      }
+      _num_queued.fetch_sub(1);
+      return task;
+    }
+  }
+  return std::nullopt;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+  current_pool = this;
+  current_queue = index;
+  while (true) {
+    std::optional<Task> task = popTask(index);
+    if (task) {
+      (*task)();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(_sleep_mutex);
+    _wakeup.wait(lock, [this] { return _stop || _num_queued.load() > 0; });
+    if (_stop) {
+      return;
+    }
+  }
+}
+
+// ####################################
+// ########     Task Group     ########
+// ####################################
+
+TaskGroup::TaskGroup(ThreadPool& pool): _pool(pool), _num_open(0), _cancelled(false), _skipped(false) { }
+
+TaskGroup::~TaskGroup() {
+  wait();
+}
+
+void TaskGroup::run(std::function<void()> task) {
+  _num_open.fetch_add(1);
+  _pool.submit([this, task = std::move(task)] {
+    if (isCancelled()) {
+      _skipped.store(true);
+    } else {
+      task();
+    }
+    _num_open.fetch_sub(1);
+  });
+}
+
+void TaskGroup::cancel() {
+  _cancelled.store(true);
+}
+
+bool TaskGroup::isCancelled() const {
+  return _cancelled.load() || cancellationRequested();
+}
+
+bool TaskGroup::wait() {
+  _pool.helpWhile([this]() noexcept { return _num_open.load() > 0; });
+  return !_skipped.load();
+}
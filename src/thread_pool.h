@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Requests cancellation of all running computations, e.g. on SIGINT (async-signal-safe)
+void requestCancellation();
+
+// whether requestCancellation was called, independent of deadlines (async-signal-safe)
+bool interruptRequested();
+
+// whether the deadline of the current thread is reached
+bool deadlineReached();
+
+// whether the computation of the current thread should stop (interrupt or deadline)
+bool cancellationRequested();
+
+// Withdraws the request of requestCancellation, so that the result of an interrupted
+// computation can still be processed (e.g. written in parallel)
+void resetCancellation();
+
+std::chrono::steady_clock::time_point deadlineAfter(double seconds);
+
+// Sets the deadline of the current thread while alive, e.g. for --time-limit (std::nullopt for none).
+// Tasks submitted to the thread pool inherit the deadline of the submitting thread, so concurrent
+// computations with different deadlines don't affect each other. Replaces the previous deadline,
+// even if it is earlier.
+class DeadlineScope {
+ public:
+  explicit DeadlineScope(std::optional<std::chrono::steady_clock::time_point> deadline);
+
+  ~DeadlineScope();
+
+  DeadlineScope(const DeadlineScope&) = delete;
+  DeadlineScope& operator=(const DeadlineScope&) = delete;
+
+  static std::optional<std::chrono::steady_clock::time_point> active();
+
+ private:
+  std::optional<std::chrono::steady_clock::time_point> _previous;
+};
+
+// work-stealing thread pool shared by all parallel stages of the pipeline
+class ThreadPool {
+ public:
+  using Task = std::function<void()>;
+
+  explicit ThreadPool(size_t num_threads);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // the pool used by the pipeline, sized by --threads of the active options
+  static ThreadPool& get();
+
+  size_t numThreads() const;
+
+  void submit(Task task);
+
+  // Waits as long as `pending()` returns true. Worker threads of this pool execute queued tasks
+  // in the meantime (so waiting within a task can not deadlock), other threads sleep.
+  void helpWhile(const std::function<bool()>& pending);
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  // pops from the own queue (newest first) or steals from another queue (oldest first)
+  std::optional<Task> popTask(size_t own_index);
+
+  void workerLoop(size_t index);
+
+  std::vector<std::unique_ptr<Queue>> _queues;
+  std::vector<std::thread> _threads;
+  std::mutex _sleep_mutex;
+  std::condition_variable _wakeup;
+  std::atomic<size_t> _num_queued;
+  std::atomic<size_t> _next_queue;
+  bool _stop;
+};
+
+// Set of tasks which is waited for as a whole. Tasks that did not start yet are skipped
+// if the group is cancelled or cancellation is requested globally.
+class TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool& pool = ThreadPool::get());
+
+  // waits for the remaining tasks
+  ~TaskGroup();
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  void run(std::function<void()> task);
+
+  void cancel();
+
+  bool isCancelled() const;
+
+  // returns false if any task was skipped
+  bool wait();
+
+ private:
+  ThreadPool& _pool;
+  std::atomic<size_t> _num_open;
+  std::atomic_bool _cancelled;
+  std::atomic_bool _skipped;
+};
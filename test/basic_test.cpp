@@ -1,7 +1,19 @@
+#include <algorithm>
 #include <assert.h>
 #include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#include "boost/property_tree/json_parser.hpp"
 
 #include "src/algorithms.h"
+#include "src/exact.h"
+#include "src/group_assignment.h"
+#include "src/io.h"
+#include "src/server.h"
+#include "src/sweep.h"
+#include "src/thread_pool.h"
 
 std::vector<StudentID>
 numPerGroup(const State &s,
@@ -135,8 +147,264 @@ int main() {
   for (StudentID num : num_per_group) {
     assert(num == 0 || num >= 2);
   }
+  flushLog();
   std::cout << "Filter test done." << std::endl << std::endl;
 
+  // concurrent library calls with separate options and log sinks
+  Config quiet_options;
+  quiet_options.verbosity_level = 0;
+  Config logging_options;
+  logging_options.random_seed = 3;
+  std::vector<std::string> log_lines;
+  const LogSink collect = [&](const std::string& line) { log_lines.push_back(line); };
+  const std::vector<std::pair<Filter, StudentID>> filters{{Filter({{is_math, 0}}, "Mathe"), 2}};
+  AssignmentResult quiet_result, logging_result;
+  std::thread quiet_thread([&] { quiet_result = runAssignment(input, filters, quiet_options); });
+  logging_result = runAssignment(input, filters, logging_options, collect);
+  quiet_thread.join();
+  assert(quiet_result.success && logging_result.success);
+  assert(quiet_result.num_type_minimum_violations == 0 && logging_result.num_type_minimum_violations == 0);
+  assert(!log_lines.empty());
+  Config no_min_sizes;
+  no_min_sizes.use_min_group_sizes = false;
+  assert(no_min_sizes.allowMinGroupSizeDefault() && !quiet_options.allowMinGroupSizeDefault());
+
+  // alternative matching engines
+  for (MatchingEngine engine : {MatchingEngine::Lapjv, MatchingEngine::Flow}) {
+    Config engine_options;
+    engine_options.verbosity_level = 0;
+    engine_options.matching_engine = engine;
+    const AssignmentResult engine_result = runAssignment(input, filters, engine_options);
+    assert(engine_result.success && engine_result.num_type_minimum_violations == 0);
+  }
+  // anytime mode: if the time limit is reached immediately, the initial assignment is calculated via flow,
+  // while a concurrent call without limit is not affected
+  Config limited_options;
+  limited_options.verbosity_level = 0;
+  limited_options.time_limit = 1e-9;
+  AssignmentResult limited_result, unlimited_result;
+  std::thread limited_thread([&] { limited_result = runAssignment(input, filters, limited_options); });
+  unlimited_result = runAssignment(input, filters, quiet_options);
+  limited_thread.join();
+  assert(limited_result.success && limited_result.time_limit_reached);
+  assert(std::count(limited_result.assignment.begin(), limited_result.assignment.end(), -1) == 0);
+  assert(unlimited_result.success && !unlimited_result.time_limit_reached);
+  assert(unlimited_result.total_weight == quiet_result.total_weight);
+  // invalid options are reported instead of exiting, the pool is chosen per call by the thread count
+  Config invalid_options(quiet_options);
+  invalid_options.capacity_buffer = 1;
+  const AssignmentResult invalid_result = runAssignment(input, filters, invalid_options);
+  assert(!invalid_result.success && !invalid_result.message.empty());
+  for (uint32_t threads : {2u, 3u}) {
+    Config threads_options(quiet_options);
+    threads_options.threads = threads;
+    Config::Scope threads_scope(&threads_options);
+    assert(ThreadPool::get().numThreads() == threads);
+  }
+  flushLog();
+  std::cout << "Library test done." << std::endl << std::endl;
+
+  // independent components: no participant can be assigned to both groups
+  Input split_input;
+  split_input.groups.emplace_back("ba", "Bachelor", 3, 0, CourseType::Any, DegreeType::Bachelor);
+  split_input.groups.emplace_back("ms", "Master", 3, 0, CourseType::Any, DegreeType::Master);
+  for (int i = 0; i < 4; ++i) {
+    const std::string id = "s" + std::to_string(i);
+    split_input.students.emplace_back(id, id, CourseType::Info, i < 2 ? DegreeType::Bachelor : DegreeType::Master,
+                                      Semester::Ersti, true);
+    split_input.ratings.emplace_back(i < 2 ? std::vector<Rating>{Rating(0), Rating(1)}
+                                           : std::vector<Rating>{Rating(1), Rating(0)});
+  }
+  State split_state(split_input, random_gen);
+  auto [split_assignment, split_success] = calculateAssignment(split_state, random_gen, true);
+  assert(split_success);
+  assert(split_assignment[0] == 0 && split_assignment[1] == 0);
+  assert(split_assignment[2] == 1 && split_assignment[3] == 1);
+
+  // infeasibility is detected with the responsible participants and groups
+  split_input.groups[0].capacity = 10;
+  split_input.groups[1].capacity = 1;
+  State infeasible_state(split_input, random_gen);
+  FeasibilityCertificate certificate = checkAssignmentFeasibility(infeasible_state, false);
+  assert(!certificate.feasible);
+  assert((certificate.participants == std::vector<ParticipantID>{2, 3}));
+  assert((certificate.groups == std::vector<GroupID>{1}));
+  assert(!calculateAssignment(infeasible_state, random_gen, false).second);
+  split_input.groups[1].capacity = 3;
+  assert(checkAssignmentFeasibility(State(split_input, random_gen), true).feasible);
+
+  // the exact solution keeps groups disabled by the heuristic
+  Input exact_input;
+  exact_input.groups.emplace_back("a", "A", 4, 0, CourseType::Any, DegreeType::Any);
+  exact_input.groups.emplace_back("b", "B", 5, 0, CourseType::Any, DegreeType::Any);
+  for (int i = 0; i < 4; ++i) {
+    const std::string id = "e" + std::to_string(i);
+    exact_input.students.emplace_back(id, id, CourseType::Info, DegreeType::Bachelor, Semester::Ersti, true);
+    exact_input.ratings.emplace_back(std::vector<Rating>{Rating(0), Rating(1)});
+  }
+  State exact_state(exact_input, random_gen);
+  exact_state.disableGroup(0);
+  assert(assignTeamsAndStudents(exact_state, true));
+  applyExactSolution(exact_state, {});
+  assert(exact_state.groupSize(0) == 0 && exact_state.groupSize(1) == 4);
+
+  // the sparsified graph has no edges to group c, the unmatched participants are inserted by the repair
+  Input repair_input;
+  repair_input.groups.emplace_back("a", "A", 2, 0, CourseType::Any, DegreeType::Any);
+  repair_input.groups.emplace_back("b", "B", 2, 0, CourseType::Any, DegreeType::Any);
+  repair_input.groups.emplace_back("c", "C", 4, 0, CourseType::Any, DegreeType::Any);
+  for (int i = 0; i < 7; ++i) {
+    const std::string id = "r" + std::to_string(i);
+    repair_input.students.emplace_back(id, id, CourseType::Info, DegreeType::Bachelor, Semester::Ersti, true);
+    repair_input.ratings.emplace_back(i % 3 == 0 ? std::vector<Rating>{Rating(1), Rating(0), Rating(2)}
+                                                 : std::vector<Rating>{Rating(0), Rating(1), Rating(2)});
+  }
+  std::vector<std::string> repair_log;
+  const LogSink collect_repair = [&](const std::string& line) { repair_log.push_back(line); };
+  Config sparse_options, complete_options;
+  complete_options.edge_sparsification = false;
+  State repaired_state(repair_input, random_gen), complete_state(repair_input, random_gen);
+  {
+    Config::Scope options_scope(&sparse_options);
+    LogScope log_scope(&collect_repair);
+    auto [repaired_assignment, repaired_success] = calculateAssignment(repaired_state, random_gen, true);
+    assert(repaired_success && applyAssignment(repaired_state, repaired_assignment));
+  }
+  {
+    Config::Scope options_scope(&complete_options);
+    auto [complete_assignment, complete_success] = calculateAssignment(complete_state, random_gen, true);
+    assert(complete_success && applyAssignment(complete_state, complete_assignment));
+  }
+  assert(std::any_of(repair_log.begin(), repair_log.end(),
+                     [](const std::string& line) { return line.find("Inserted 3 unmatched") != std::string::npos; }));
+  assert(std::none_of(repair_log.begin(), repair_log.end(),
+                      [](const std::string& line) { return line.find("Restarting") != std::string::npos; }));
+  for (GroupID group = 0; group < repaired_state.numGroups(); ++group) {
+    assert(repaired_state.groupSize(group) <= repair_input.groups[group].capacity);
+  }
+  assert(repaired_state.groupSize(2) == 3);
+  assert(totalWeight(repaired_state) == totalWeight(complete_state));
+
+  // server: warm re-solve after reducing the capacities, invalid requests are rejected
+  Input server_input;
+  for (int i = 0; i < 4; ++i) {
+    const std::string id = "g" + std::to_string(i);
+    server_input.groups.emplace_back(id, id, 8, 0, CourseType::Any, DegreeType::Any);
+  }
+  for (int i = 0; i < 15; ++i) {
+    const std::string id = "s" + std::to_string(i);
+    server_input.students.emplace_back(id, id, CourseType::Info, DegreeType::Bachelor, Semester::Ersti, true);
+    std::vector<Rating> ratings;
+    for (int group = 0; group < 4; ++group) {
+      ratings.emplace_back((i / 3 + group) % 4);
+    }
+    server_input.ratings.emplace_back(ratings);
+  }
+  for (StudentID team = 0; team < 4; ++team) {
+    server_input.teams.emplace_back("t" + std::to_string(team), std::vector<StudentID>{3 * team, 3 * team + 1, 3 * team + 2});
+  }
+  const std::vector<std::pair<Filter, StudentID>> no_filters;
+  AssignmentServer server(server_input, no_filters);
+  auto handle = [](AssignmentServer& target, const std::string& json) {
+    PTree request_tree, response;
+    std::istringstream in(json);
+    boost::property_tree::json_parser::read_json(in, request_tree);
+    target.handle(request_tree, response);
+    return response;
+  };
+  auto request = [&](const std::string& json) { return handle(server, json); };
+  assert(request(R"({"command": "solve"})").get<std::string>("status") == "ok");
+  for (int i = 0; i < 4; ++i) {
+    request(R"({"command": "set_capacity", "group": "g)" + std::to_string(i) + R"(", "capacity": 4})");
+  }
+  assert(request(R"({"command": "solve"})").get<std::string>("status") == "ok");
+  const PTree server_output = request(R"({"command": "result"})").get_child("output");
+  std::map<std::string, int> students_per_group;
+  for (const auto& [student, group] : server_output) {
+    students_per_group[group.get_value<std::string>()]++;
+  }
+  assert(server_output.size() == 15);
+  for (const auto& [group, num] : students_per_group) {
+    assert(num <= 4);
+  }
+  assert(request(R"({"command": "add_participants", "students": {"s0": {"name": "s0", "course_type": "info",
+                                                     "degree_type": "bachelor"}}})").get<std::string>("status") == "error");
+  assert(request(R"({"command": "set_capacity", "group": "g0", "capacity": 1})").get<std::string>("status") == "ok");
+  assert(request(R"({"command": "solve"})").get<std::string>("status") == "error");
+  // capacities at the min size or just above don't fit the slot bonus ladder, negative ones are not wrapped
+  Input min_size_input(server_input);
+  min_size_input.groups[0].min_target_size = 2;
+  AssignmentServer min_size_server(min_size_input, no_filters);
+  for (const char* capacity : {"2", "3", "4", "-1", "4294967296"}) {
+    assert(handle(min_size_server, std::string(R"({"command": "set_capacity", "group": "g0", "capacity": )") + capacity
+                  + "}").get<std::string>("status") == "error");
+  }
+  assert(handle(min_size_server, R"({"command": "set_capacity", "group": "g0", "capacity": 6})")
+         .get<std::string>("status") == "ok");
+  assert(handle(min_size_server, R"({"command": "solve"})").get<std::string>("status") == "ok");
+  min_size_input.groups[0].capacity = 3;
+  assert(!State::checkInput(min_size_input).empty());
+  flushLog();
+  std::cout << "Server test done." << std::endl << std::endl;
+
+  // top-k ratings with default tail
+  RatingList top_k(10, {{7, Rating(1)}, {2, Rating(0)}, {7, Rating(2)}}, Rating(9));
+  assert(top_k.isSparse() && top_k.size() == 10 && top_k.isComplete());
+  assert(top_k[2] == Rating(0) && top_k[7] == Rating(2) && top_k[5] == Rating(9));
+  RatingList top_k_dense(std::vector<Rating>(10, Rating(9)));
+  assert(!(top_k == top_k_dense));
+  GroupID num_visited = 0;
+  for (const auto [group, rating] : top_k) {
+    assert(group == num_visited++ && rating == top_k.at(group));
+  }
+  assert(num_visited == top_k.size());
+  RatingList incomplete(10, {{3, Rating(0)}});
+  assert(!incomplete.isComplete());
+  incomplete.setDefault(Rating(9));
+  assert(incomplete.isComplete() && incomplete[4] == Rating(9));
+
+  // csv fields with separators, quotes or line breaks are quoted
+  std::string csv_row;
+  appendCsvRow({"Gruppe, A", "Max \"M\" Muster", "id\n2", "plain"}, csv_row);
+  assert(csv_row == "\"Gruppe, A\",\"Max \"\"M\"\" Muster\",\"id\n2\",plain\n");
+
+  // parameter sweep: parsing, expansion and option overrides
+  std::istringstream sweep_file("# comment\n\n  random-seed = 1, 2 ,\nmatching-engine=flow,lapjv\n");
+  const SweepGrid grid = parseSweepFile(sweep_file);
+  assert(grid.size() == 2);
+  assert(grid[0].first == "random-seed" && (grid[0].second == std::vector<std::string>{"1", "2"}));
+  assert(grid[1].first == "matching-engine" && (grid[1].second == std::vector<std::string>{"flow", "lapjv"}));
+  const auto combinations = expandSweepGrid(grid);
+  assert(combinations.size() == 4);
+  assert((combinations[1] == std::vector<std::pair<std::string, std::string>>{{"random-seed", "1"},
+                                                                            {"matching-engine", "lapjv"}}));
+  assert(combinations[2][0].second == "2" && combinations[2][1].second == "flow");
+  assert(expandSweepGrid({}).size() == 1 && expandSweepGrid({}).front().empty());
+  std::string override_error;
+  const std::optional<Config> overridden = Config::withOverrides(combinations[3], override_error);
+  assert(overridden && overridden->random_seed == 2 && overridden->matching_engine == MatchingEngine::Lapjv);
+  assert(Config::get().random_seed == 7 && Config::get().matching_engine == MatchingEngine::Blossom);
+  assert(!Config::withOverrides({{"matching-engine", "flwo"}}, override_error) && !override_error.empty());
+  {
+    // based on the options of the current thread
+    Config::Scope options_scope(&limited_options);
+    const std::optional<Config> scoped = Config::withOverrides({{"matching-engine", "flow"}}, override_error);
+    assert(scoped->time_limit == limited_options.time_limit && scoped->matching_engine == MatchingEngine::Flow);
+  }
+  // invalid combinations are reported in their rows, the others are still calculated
+  std::istringstream invalid_sweep_file("capacity-buffer-factor = 1, 1.05\nmatching-engine = flow, flwo\n");
+  std::ostringstream sweep_out;
+  runSweep(input, filters, parseSweepFile(invalid_sweep_file), sweep_out);
+  std::istringstream sweep_rows(sweep_out.str());
+  std::vector<std::string> rows;
+  for (std::string row; std::getline(sweep_rows, row);) {
+    rows.push_back(row);
+  }
+  assert(rows.size() == 5 && rows[0].substr(rows[0].rfind(',')) == ",message");
+  assert(rows[1].find(",no,") != std::string::npos && rows[1].find("capacity-buffer-factor") != std::string::npos);
+  assert(rows[2].find(",no,") != std::string::npos && rows[2].find("Invalid option override") != std::string::npos);
+  assert(rows[3].find(",yes,") != std::string::npos && rows[4].find(",no,") != std::string::npos);
+
   // test filters
   // input.students.emplace_back("lx", "Lerngruppenteilnehmer X", CourseType::Mathe, DegreeType::Any, Semester::Ersti, true);
   // input.ratings.emplace_back(
@@ -156,5 +424,6 @@ int main() {
   // assert(!s.isExludedFromGroup(2, 0));
   // assert(!s.isExludedFromGroup(3, 0));
   // assert(s.isExludedFromGroup(7, 0));
+  flushLog();
   std::cout << "Basic test successful!" << std::endl;
 }
@@ -3,6 +3,8 @@ A test using randomly generated data of similar size to the real data.
 */
 
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <random>
 
@@ -10,6 +12,7 @@ A test using randomly generated data of similar size to the real data.
 
 #include "src/config.h"
 #include "src/algorithms.h"
+#include "src/group_assignment.h"
 
 namespace po = boost::program_options;
 
@@ -78,7 +81,7 @@ int main(int argc, const char *argv[]) {
   for (int team_counter = 0; team_counter < num_teams; ++team_counter) {
     int team_size = random(GENERATOR);
     std::vector<StudentID> members;
-    const std::vector<Rating> &rating = input.ratings[student_id];
+    const RatingList &rating = input.ratings[student_id];
     for (int i = 0; i < team_size; ++i) {
       input.ratings[student_id] = rating;
       members.push_back(student_id++);
@@ -90,7 +93,8 @@ int main(int argc, const char *argv[]) {
 
   std::mt19937_64 random_gen;
   State s(input, random_gen);
-  assignWithMinimumNumberPerGroup(s, Config::get().group_disable_threshold);
+  const bool success = assignWithMinimumNumberPerGroup(s, Config::get().group_disable_threshold);
+  ASSERT(success);
   auto is_math_and_no_ma = [](const StudentData &data) noexcept {
     return data.course_type == CourseType::Mathe &&
            data.degree_type != DegreeType::Master;
@@ -107,6 +111,7 @@ int main(int argc, const char *argv[]) {
     return data.degree_type == DegreeType::Master;
   };
 
+  flushLog();
   std::cout << std::endl << "Reassigning specific students." << std::endl;
   assertMinimumNumberPerGroupForSpecificType(s, {
     {Filter({{is_math_and_no_ma, 0}}, "Mathe (BA)"), 5},
@@ -114,4 +119,22 @@ int main(int argc, const char *argv[]) {
     {Filter({{is_dritti_and_no_ma, 2}}, "Dritti (BA)"), 7},
     {Filter({{is_master, 3}}, "Master"), 5}
   });
+
+  // anytime mode: with speculative variants on several threads, the run must still end within the time
+  // limit plus the budget of the flow fallback (and some slack for writing the result)
+  Config limited_options = Config::get();
+  limited_options.verbosity_level = 0;
+  limited_options.threads = 2;
+  limited_options.speculative_candidates = 3;
+  limited_options.speculative_filter_batches = 2;
+  limited_options.time_limit = 2;
+  const auto start = std::chrono::steady_clock::now();
+  const AssignmentResult limited_result = runAssignment(input, {{Filter({{is_master, 3}}, "Master"), 5}},
+                                                        limited_options);
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  flushLog();
+  std::cout << std::endl << "Time limited run: " << seconds << "s" << std::endl;
+  ASSERT(limited_result.success && limited_result.time_limit_reached);
+  const double fallback_seconds = std::max(1.0, 0.5 * limited_options.time_limit);
+  ASSERT_WITH(seconds < limited_options.time_limit + fallback_seconds + 2, "Time limit exceeded: " << seconds << "s");
 }